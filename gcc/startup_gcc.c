@@ -43,6 +43,14 @@ static void IntDefaultHandler(void);
 //*****************************************************************************
 extern int main(void);
 
+//*****************************************************************************
+//
+// External declarations for the interrupt handlers used by the application.
+//
+//*****************************************************************************
+extern void clock_isr(void);
+extern void nic_isr(void);
+
 //*****************************************************************************
 //
 // Reserve space for the system stack.
@@ -75,9 +83,9 @@ void (* const g_pfnVectors[])(void) =
     IntDefaultHandler,                      // Debug monitor handler
     0,                                      // Reserved
     IntDefaultHandler,                      // The PendSV handler
-    IntDefaultHandler,                      // The SysTick handler
+    clock_isr,                              // The SysTick handler
     IntDefaultHandler,                      // GPIO Port A
-    IntDefaultHandler,                      // GPIO Port B
+    nic_isr,                                // GPIO Port B
     IntDefaultHandler,                      // GPIO Port C
     IntDefaultHandler,                      // GPIO Port D
     IntDefaultHandler,                      // GPIO Port E
@@ -34,7 +34,12 @@
 #ifndef __CLOCK_ARCH_H__
 #define __CLOCK_ARCH_H__
 
-typedef int clock_time_t;
+/* The tick counter wraps, so it is unsigned. Points in time are
+   compared through the signed difference, see CLOCK_LT(). */
+typedef unsigned int clock_time_t;
+typedef int clock_diff_t;
 #define CLOCK_CONF_SECOND 1000
 
+void clock_isr(void);
+
 #endif /* __CLOCK_ARCH_H__ */
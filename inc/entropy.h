@@ -0,0 +1,14 @@
+#ifndef __ENTROPY_H__
+#define __ENTROPY_H__
+
+#include <stdint.h>
+
+/* Set up the sampling and gather the initial pool. Must be called
+ * after clock_init(). */
+void entropy_init(void);
+
+/* Return 32 bits derived from the pool and fresh samples, for keys
+ * such as uip_syncookie_secret. */
+uint32_t entropy_get(void);
+
+#endif /* __ENTROPY_H__ */
@@ -32,11 +32,14 @@
 /* Next, we define the uip_tcp_appstate_t datatype. This is the state
    of our application, and the memory required for this state is
    allocated together with each TCP connection. One application state
-   for each TCP connection. */
+   for each TCP connection. With UIP_TCP_APPSTATE_POOL, the state is
+   instead allocated from a pool when the connection is established,
+   see hello-world.c. */
 typedef struct hello_world_state {
   struct psock p;
-  char inputbuffer[10];
+  char outputbuffer[64];
   char name[40];
+  u8_t namelen;
 } uip_tcp_appstate_t;
 
 /* Finally we define the application function to be called by uIP. */
@@ -3,9 +3,27 @@
 
 #include <stdint.h>
 
+/* Maximum number of frames the main loop reads before it services the
+ * timers and pending application sends. */
+#ifndef NIC_RX_BUDGET
+#define NIC_RX_BUDGET 8
+#endif
+
+struct nic_stats {
+    uint32_t rx_frames;         /* Frames read from the NIC. */
+    uint32_t budget_exhausted;  /* Receive rounds that used the whole budget. */
+    uint32_t poll_mode;         /* Switches from interrupt to polling mode. */
+    uint32_t intr_mode;         /* Switches from polling to interrupt mode. */
+};
+
+extern struct nic_stats nic_stats;
+
 int nic_init(void);
+int nic_pending(void);
 int nic_read(uint8_t *buf);
 void nic_write(uint8_t *buf, int size);
+void nic_split_output(void);
+void nic_poll_done(int budget_exhausted);
+void nic_isr(void);
 
 #endif /* __NIC_H__ */
-
@@ -83,6 +83,18 @@ clock_time_t clock_time(void);
 #define CLOCK_SECOND (clock_time_t)32
 #endif
 
+/**
+ * Check if clock time a is before clock time b.
+ *
+ * The clock wraps around, so two points in time are compared through
+ * their difference, cast to the signed clock_diff_t type. The result
+ * is correct as long as the two are less than half the range of
+ * clock_time_t apart.
+ *
+ * \hideinitializer
+ */
+#define CLOCK_LT(a, b) ((clock_diff_t)((a) - (b)) < 0)
+
 #endif /* __CLOCK_H__ */
 
 /** @} */
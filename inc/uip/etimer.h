@@ -0,0 +1,89 @@
+/**
+ * \defgroup etimer Event timers
+ * @{
+ *
+ * Event timers are timers from the \ref timer "Timer library" that
+ * post a PROCESS_EVENT_TIMER event to the process that set them when
+ * they expire, so a process can block on a timer with
+ * PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et)) instead of checking it
+ * from every pass through the main loop.
+ *
+ * The timers are managed by the etimer_process, which must be started
+ * with process_start() before any event timer is set. The clock
+ * driver should call etimer_request_poll() when the time returned by
+ * etimer_next_expiration_time() has been reached.
+ */
+
+/**
+ * \file
+ * Event timer header file.
+ */
+
+/*
+ * Copyright (c) 2004, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the uIP TCP/IP stack
+ *
+ * Author: Adam Dunkels <adam@sics.se>
+ *
+ */
+#ifndef __ETIMER_H__
+#define __ETIMER_H__
+
+#include "timer.h"
+#include "process.h"
+
+/**
+ * An event timer.
+ *
+ * The fields are private to the event timer library; the timer is
+ * accessed only through the etimer_*() functions.
+ *
+ * \hideinitializer
+ */
+struct etimer {
+  struct timer timer;
+  struct etimer *next;
+  struct process *p;
+};
+
+void etimer_set(struct etimer *et, clock_time_t interval);
+void etimer_reset(struct etimer *et);
+void etimer_restart(struct etimer *et);
+void etimer_stop(struct etimer *et);
+int etimer_expired(struct etimer *et);
+
+void etimer_request_poll(void);
+int etimer_pending(void);
+clock_time_t etimer_next_expiration_time(void);
+
+PROCESS_NAME(etimer_process);
+
+#endif /* __ETIMER_H__ */
+
+/** @} */
@@ -0,0 +1,353 @@
+/**
+ * \defgroup process Protothread processes
+ * @{
+ *
+ * A process is a protothread that is run by a small cooperative
+ * scheduler. Processes are driven by events: an event is either
+ * posted to a single process or broadcast to all running processes,
+ * and is queued until the scheduler gets around to delivering it. A
+ * process can also be polled, which is a way for an interrupt handler
+ * or another process to ask it to run as soon as possible without
+ * using a slot in the event queue.
+ *
+ * The scheduler is run by calling process_run() from the main loop
+ * of the system. Each call first runs all processes that have been
+ * polled and then delivers one event from the event queue.
+ *
+ * Since processes are protothreads, local variables are not preserved
+ * across the blocking macros (PROCESS_WAIT_EVENT() and friends);
+ * state that must survive a wait has to be declared static.
+ *
+ * Example:
+ \code
+ PROCESS(blink_process, "Blink");
+
+ PROCESS_THREAD(blink_process, ev, data)
+ {
+   static struct etimer et;
+
+   PROCESS_BEGIN();
+
+   etimer_set(&et, CLOCK_SECOND);
+   while(1) {
+     PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+     toggle_led();
+     etimer_reset(&et);
+   }
+
+   PROCESS_END();
+ }
+ \endcode
+ */
+
+/**
+ * \file
+ * Header file for the protothread process scheduler.
+ */
+
+/*
+ * Copyright (c) 2005, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the uIP TCP/IP stack
+ *
+ * Author: Adam Dunkels <adam@sics.se>
+ *
+ */
+#ifndef __PROCESS_H__
+#define __PROCESS_H__
+
+#include <stddef.h>
+
+#include "pt.h"
+
+/**
+ * Size of the event queue.
+ *
+ * This must be a power of two, so that the queue index can be wrapped
+ * with a mask instead of a division.
+ *
+ * \hideinitializer
+ */
+#ifdef PROCESS_CONF_NUMEVENTS
+#define PROCESS_NUMEVENTS PROCESS_CONF_NUMEVENTS
+#else
+#define PROCESS_NUMEVENTS 8
+#endif
+
+typedef unsigned char process_event_t;
+typedef void *        process_data_t;
+typedef unsigned char process_num_events_t;
+
+/**
+ * \name Return values
+ * @{
+ */
+
+/** The event was posted. */
+#define PROCESS_ERR_OK        0
+/** The event queue was full and the event was dropped. */
+#define PROCESS_ERR_FULL      1
+
+/** @} */
+
+#define PROCESS_NONE          NULL
+
+/**
+ * \name Process events
+ * @{
+ *
+ * Events below PROCESS_EVENT_NONE are free for the application to
+ * number as it likes. The events from PROCESS_EVENT_NONE to
+ * PROCESS_EVENT_TIMER are used by the system, and process_alloc_event()
+ * hands out the numbers from PROCESS_EVENT_MAX and up.
+ */
+
+#define PROCESS_EVENT_NONE            0x80
+#define PROCESS_EVENT_INIT            0x81
+#define PROCESS_EVENT_POLL            0x82
+#define PROCESS_EVENT_EXIT            0x83
+#define PROCESS_EVENT_CONTINUE        0x84
+#define PROCESS_EVENT_MSG             0x85
+#define PROCESS_EVENT_EXITED          0x86
+#define PROCESS_EVENT_TIMER           0x87
+#define PROCESS_EVENT_MAX             0x88
+
+/** @} */
+
+/** Post the event to all running processes. */
+#define PROCESS_BROADCAST NULL
+
+/**
+ * \name Process protothread macros
+ * @{
+ */
+
+/**
+ * Define the beginning of a process.
+ *
+ * This macro must be the first statement in the body of a
+ * PROCESS_THREAD().
+ *
+ * \hideinitializer
+ */
+#define PROCESS_BEGIN()             PT_BEGIN(process_pt)
+
+/**
+ * Define the end of a process.
+ *
+ * \hideinitializer
+ */
+#define PROCESS_END()               PT_END(process_pt)
+
+/**
+ * Wait for any event to be delivered to the process.
+ *
+ * \hideinitializer
+ */
+#define PROCESS_WAIT_EVENT()        PROCESS_YIELD()
+
+/**
+ * Wait for an event, but only return when a condition is true.
+ *
+ * The condition is evaluated each time an event is delivered, so
+ * typically it tests the \c ev and \c data arguments.
+ *
+ * \hideinitializer
+ */
+#define PROCESS_WAIT_EVENT_UNTIL(c) PROCESS_YIELD_UNTIL(c)
+
+/**
+ * Yield the process until the next event is delivered.
+ *
+ * \hideinitializer
+ */
+#define PROCESS_YIELD()             PT_YIELD(process_pt)
+
+/**
+ * Yield the process until the next event is delivered and the
+ * condition is true.
+ *
+ * \hideinitializer
+ */
+#define PROCESS_YIELD_UNTIL(c)      PT_YIELD_UNTIL(process_pt, c)
+
+/**
+ * Wait for a condition without necessarily yielding.
+ *
+ * If the condition is already true the process continues right away.
+ *
+ * \hideinitializer
+ */
+#define PROCESS_WAIT_UNTIL(c)       PT_WAIT_UNTIL(process_pt, c)
+#define PROCESS_WAIT_WHILE(c)       PT_WAIT_WHILE(process_pt, c)
+
+/**
+ * Exit the process.
+ *
+ * \hideinitializer
+ */
+#define PROCESS_EXIT()              PT_EXIT(process_pt)
+
+/**
+ * Spawn a protothread from the process and wait for it to finish.
+ *
+ * \hideinitializer
+ */
+#define PROCESS_PT_SPAWN(pt, thread) PT_SPAWN(process_pt, pt, thread)
+
+/**
+ * Yield the process for a short while.
+ *
+ * The process posts a PROCESS_EVENT_CONTINUE event to itself and
+ * waits for it, which gives all other processes a chance to run.
+ *
+ * \hideinitializer
+ */
+#define PROCESS_PAUSE()             do {				\
+  process_post(PROCESS_CURRENT(), PROCESS_EVENT_CONTINUE, NULL);	\
+  PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_CONTINUE);		\
+} while(0)
+
+/**
+ * Specify code to run when the process is polled.
+ *
+ * Must be placed directly after PROCESS_BEGIN().
+ *
+ * \hideinitializer
+ */
+#define PROCESS_POLLHANDLER(handler) if(ev == PROCESS_EVENT_POLL) { handler; }
+
+/**
+ * Specify code to run when the process exits.
+ *
+ * Must be placed directly after PROCESS_BEGIN().
+ *
+ * \hideinitializer
+ */
+#define PROCESS_EXITHANDLER(handler) if(ev == PROCESS_EVENT_EXIT) { handler; }
+
+/** @} */
+
+/**
+ * \name Process declaration and definition
+ * @{
+ */
+
+/**
+ * Define the body of a process.
+ *
+ * \param name The variable name of the process structure.
+ * \param ev The name of the event argument.
+ * \param data The name of the data argument.
+ *
+ * \hideinitializer
+ */
+#define PROCESS_THREAD(name, ev, data)				\
+static PT_THREAD(process_thread_##name(struct pt *process_pt,	\
+				       process_event_t ev,	\
+				       process_data_t data))
+
+/**
+ * Declare a process defined in another file.
+ *
+ * \hideinitializer
+ */
+#define PROCESS_NAME(name) extern struct process name
+
+/**
+ * Declare a process.
+ *
+ * \param name The variable name of the process structure.
+ * \param strname A textual name of the process, used for debugging.
+ *
+ * \hideinitializer
+ */
+#define PROCESS(name, strname)				\
+  PROCESS_THREAD(name, ev, data);			\
+  struct process name = { NULL, strname,		\
+                          process_thread_##name, {0}, 0, 0 }
+
+/** @} */
+
+/**
+ * A process.
+ *
+ * Declared with the PROCESS() macro; the fields are private to the
+ * scheduler.
+ */
+struct process {
+  struct process *next;
+  const char *name;
+  PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
+  struct pt pt;
+  unsigned char state, needspoll;
+};
+
+/**
+ * \name Process functions
+ * @{
+ */
+
+void process_start(struct process *p, const char *arg);
+int process_post(struct process *p, process_event_t ev, process_data_t data);
+void process_post_synch(struct process *p,
+			process_event_t ev, process_data_t data);
+void process_exit(struct process *p);
+void process_poll(struct process *p);
+process_event_t process_alloc_event(void);
+int process_is_running(struct process *p);
+
+/**
+ * The currently running process, or NULL if no process is running.
+ *
+ * \hideinitializer
+ */
+#define PROCESS_CURRENT() process_current
+extern struct process *process_current;
+
+/**
+ * The list of running processes.
+ */
+extern struct process *process_list;
+
+/** @} */
+
+/**
+ * \name System functions
+ * @{
+ */
+
+void process_init(void);
+int process_run(void);
+process_num_events_t process_nevents(void);
+
+/** @} */
+
+#endif /* __PROCESS_H__ */
+
+/** @} */
@@ -97,6 +97,14 @@ struct psock_buf {
   unsigned short left;
 };
 
+/**
+ * A piece of data to be sent with PSOCK_SENDV().
+ */
+struct psock_iov {
+  const char *ptr;       /* Pointer to the data. */
+  u16_t len;             /* The length of the data. */
+};
+
 /**
  * The representation of a protosocket.
  *
@@ -108,6 +116,10 @@ struct psock {
 			    functions, and one that runs inside the
 			    psock functions. */
   const u8_t *sendptr;   /* Pointer to the next data to be sent. */
+  const struct psock_iov *sendiov; /* The piece of a PSOCK_SENDV() that
+				      holds the next data to be sent, or
+				      NULL. */
+  u16_t sendoff;         /* Offset of the next data in sendiov. */
   u8_t *readptr;         /* Pointer to the next data to be read. */
   
   char *bufptr;          /* Pointer to the buffer used for buffering
@@ -119,6 +131,11 @@ struct psock {
   struct psock_buf buf;  /* The structure holding the state of the
 			    input buffer. */
   unsigned int bufsize;  /* The size of the input buffer. */
+
+  char *outbufptr;       /* Pointer to the buffer used for coalescing
+			    outgoing data, or NULL. */
+  u16_t outbufsize;      /* The size of the output buffer. */
+  u16_t outlen;          /* The number of bytes in the output buffer. */
   
   unsigned char state;   /* The state of the protosocket. */
 };
@@ -144,6 +161,29 @@ void psock_init(struct psock *psock, char *buffer, unsigned int buffersize);
 #define PSOCK_INIT(psock, buffer, buffersize) \
   psock_init(psock, buffer, buffersize)
 
+void psock_outbuf(struct psock *psock, char *buffer, u16_t buffersize);
+/**
+ * Set the output buffer of a protosocket.
+ *
+ * This macro gives the protosocket a buffer in which data written
+ * with PSOCK_WRITE() is collected, so that several small writes go
+ * out as one TCP segment. It must be called after PSOCK_INIT(). The
+ * buffer should be no larger than the MSS of the connection
+ * (uip_mss()), since anything beyond that is sent as a separate
+ * segment anyway.
+ *
+ * \param psock (struct psock *) A pointer to the protosocket.
+ *
+ * \param buffer (char *) A pointer to the output buffer for the
+ * protosocket.
+ *
+ * \param buffersize (u16_t) The size of the output buffer.
+ *
+ * \hideinitializer
+ */
+#define PSOCK_OUTBUF(psock, buffer, buffersize) \
+  psock_outbuf(psock, buffer, buffersize)
+
 /**
  * Start the protosocket protothread in a function.
  *
@@ -191,6 +231,103 @@ PT_THREAD(psock_send(struct psock *psock, const char *buf, unsigned int len));
 #define PSOCK_SEND_STR(psock, str)      		\
     PT_WAIT_THREAD(&((psock)->pt), psock_send(psock, str, strlen(str)))
 
+PT_THREAD(psock_sendv(struct psock *psock, const struct psock_iov *iov,
+		      unsigned int iovcnt));
+/**
+ * Send data from several buffers.
+ *
+ * This macro sends the pieces of data described by an array of
+ * struct psock_iov as one stream, for example a header built in RAM
+ * followed by a body in flash. Each TCP segment is gathered from the
+ * pieces directly into the uip_appdata buffer when it is sent, and
+ * again if it has to be retransmitted, so no staging buffer is needed
+ * and small pieces share segments. The protosocket protothread blocks
+ * until all data has been sent and is known to have been received by
+ * the remote end of the TCP connection.
+ *
+ * The array and the data must stay unchanged until the macro
+ * returns, so they cannot be local variables of the protothread
+ * function.
+ *
+ * Example:
+ \code
+ static const char body[] = "...";
+
+ s->iov[0].ptr = s->header;
+ s->iov[0].len = s->headerlen;
+ s->iov[1].ptr = body;
+ s->iov[1].len = sizeof(body) - 1;
+ PSOCK_SENDV(&s->p, s->iov, 2);
+ \endcode
+ *
+ * \param psock (struct psock *) A pointer to the protosocket over which
+ * data is to be sent.
+ *
+ * \param iov (struct psock_iov *) A pointer to the array of pieces.
+ *
+ * \param iovcnt (unsigned int) The number of pieces in the array.
+ *
+ * \hideinitializer
+ */
+#define PSOCK_SENDV(psock, iov, iovcnt)			\
+    PT_WAIT_THREAD(&((psock)->pt), psock_sendv(psock, iov, iovcnt))
+
+PT_THREAD(psock_write(struct psock *psock, const char *buf, unsigned int len));
+/**
+ * Write data to the output buffer.
+ *
+ * This macro appends data to the output buffer specified with
+ * PSOCK_OUTBUF(). The protosocket protothread only blocks if the
+ * buffer has to be sent out to make room for the data. Data that
+ * does not fit in the buffer at all is sent as with PSOCK_SEND().
+ *
+ * The buffered data is sent by PSOCK_FLUSH(), before data sent with
+ * PSOCK_SEND(), PSOCK_SENDV() or PSOCK_GENERATOR_SEND(), when the
+ * protosocket starts waiting for incoming data with PSOCK_READTO(),
+ * PSOCK_READBUF() or PSOCK_PEEK(), and by PSOCK_CLOSE() and
+ * PSOCK_EXIT().
+ *
+ * \param psock (struct psock *) A pointer to the protosocket over which
+ * data is to be sent.
+ *
+ * \param data (char *) A pointer to the data that is to be written.
+ *
+ * \param datalen (unsigned int) The length of the data that is to be
+ * written.
+ *
+ * \hideinitializer
+ */
+#define PSOCK_WRITE(psock, data, datalen)		\
+    PT_WAIT_THREAD(&((psock)->pt), psock_write(psock, data, datalen))
+
+/**
+ * \brief      Write a null-terminated string to the output buffer.
+ * \param psock Pointer to the protosocket.
+ * \param str  The string to be written.
+ *
+ *             This function writes a null-terminated string with
+ *             PSOCK_WRITE().
+ *
+ * \hideinitializer
+ */
+#define PSOCK_WRITE_STR(psock, str)			\
+    PT_WAIT_THREAD(&((psock)->pt), psock_write(psock, str, strlen(str)))
+
+PT_THREAD(psock_flush(struct psock *psock));
+/**
+ * Send the data in the output buffer.
+ *
+ * This macro sends the data collected with PSOCK_WRITE() and blocks
+ * until it is known to have been received by the remote end of the
+ * TCP connection.
+ *
+ * \param psock (struct psock *) A pointer to the protosocket.
+ *
+ * \hideinitializer
+ */
+#define PSOCK_FLUSH(psock)				\
+    PT_WAIT_THREAD(&((psock)->pt), psock_flush(psock))
+
 PT_THREAD(psock_generator_send(struct psock *psock,
 				unsigned short (*f)(void *), void *arg));
 
@@ -225,14 +362,20 @@ PT_THREAD(psock_generator_send(struct psock *psock,
  * Close a protosocket.
  *
  * This macro closes a protosocket and can only be called from within the
- * protothread in which the protosocket lives.
+ * protothread in which the protosocket lives. Data written with
+ * PSOCK_WRITE() is sent first, and the protothread blocks until it
+ * has been acknowledged.
  *
  * \param psock (struct psock *) A pointer to the protosocket that is to
  * be closed.
  *
  * \hideinitializer
  */
-#define PSOCK_CLOSE(psock) uip_close()
+#define PSOCK_CLOSE(psock)			\
+  do {						\
+    PSOCK_FLUSH(psock);				\
+    uip_close();				\
+  } while(0)
 
 PT_THREAD(psock_readbuf(struct psock *psock));
 /**
@@ -268,6 +411,84 @@ PT_THREAD(psock_readto(struct psock *psock, unsigned char c));
 #define PSOCK_READTO(psock, c)				\
   PT_WAIT_THREAD(&((psock)->pt), psock_readto(psock, c))
 
+PT_THREAD(psock_peek(struct psock *psock));
+/**
+ * Wait for data without copying it.
+ *
+ * This macro blocks until there is unread data from the remote end,
+ * and then gives access to it where it lies in the uip_appdata
+ * buffer, through PSOCK_PEEKPTR() and PSOCK_PEEKLEN(). Unlike
+ * PSOCK_READTO() and PSOCK_READBUF(), no input buffer is needed, so
+ * the application can parse lines of any length in place.
+ *
+ * The data stays unread until it is consumed with PSOCK_CONSUME(). It
+ * is only valid until the protothread blocks, since uip_appdata is
+ * reused for the next segment, so all of it must be consumed before
+ * the protothread waits again. Data written with PSOCK_WRITE() is
+ * sent before the macro blocks.
+ *
+ * Typically, this macro is used as follows:
+ *
+ \code
+ do {
+   PSOCK_PEEK(&s->p);
+   len = PSOCK_PEEKLEN(&s->p);
+   end = memchr(PSOCK_PEEKPTR(&s->p), '\n', len);
+   if(end != NULL) {
+     len = end - PSOCK_PEEKPTR(&s->p) + 1;
+   }
+   parse(s, PSOCK_PEEKPTR(&s->p), len);
+   PSOCK_CONSUME(&s->p, len);
+ } while(end == NULL);
+ \endcode
+ *
+ * \param psock (struct psock *) A pointer to the protosocket from which
+ * data should be read.
+ *
+ * \hideinitializer
+ */
+#define PSOCK_PEEK(psock)				\
+  PT_WAIT_THREAD(&((psock)->pt), psock_peek(psock))
+
+/**
+ * A pointer to the unread data.
+ *
+ * This macro returns a pointer to the data made available by
+ * PSOCK_PEEK() that has not yet been consumed.
+ *
+ * \param psock (struct psock *) A pointer to the protosocket.
+ *
+ * \hideinitializer
+ */
+#define PSOCK_PEEKPTR(psock) ((psock)->readptr)
+
+/**
+ * The length of the unread data.
+ *
+ * This macro returns the number of bytes at PSOCK_PEEKPTR().
+ *
+ * \param psock (struct psock *) A pointer to the protosocket.
+ *
+ * \hideinitializer
+ */
+#define PSOCK_PEEKLEN(psock) ((psock)->readlen)
+
+void psock_consume(struct psock *psock, u16_t len);
+/**
+ * Consume data made available by PSOCK_PEEK().
+ *
+ * This macro marks the first bytes at PSOCK_PEEKPTR() as read. The
+ * next PSOCK_PEEK(), PSOCK_READTO() or PSOCK_READBUF() starts after
+ * them.
+ *
+ * \param psock (struct psock *) A pointer to the protosocket.
+ *
+ * \param len (u16_t) The number of bytes to consume.
+ *
+ * \hideinitializer
+ */
+#define PSOCK_CONSUME(psock, len) psock_consume(psock, len)
+
 /**
  * The length of the data that was previously read.
  *
@@ -286,7 +507,10 @@ u16_t psock_datalen(struct psock *psock);
  * Exit the protosocket's protothread.
  *
  * This macro terminates the protothread of the protosocket and should
- * almost always be used in conjunction with PSOCK_CLOSE().
+ * almost always be used in conjunction with PSOCK_CLOSE(). It does
+ * not wait for the connection, since it is also used when the
+ * connection has been aborted or has timed out: data written with
+ * PSOCK_WRITE() and not yet sent is discarded.
  *
  * \sa PSOCK_CLOSE_EXIT()
  *
@@ -294,7 +518,11 @@ u16_t psock_datalen(struct psock *psock);
  *
  * \hideinitializer
  */
-#define PSOCK_EXIT(psock) PT_EXIT(&((psock)->pt))
+#define PSOCK_EXIT(psock)			\
+  do {						\
+    (psock)->outlen = 0;			\
+    PT_EXIT(&((psock)->pt));			\
+  } while(0)
 
 /**
  * Close a protosocket and exit the protosocket's protothread.
@@ -75,6 +75,15 @@ typedef uint8_t u8_t;
  */
 typedef uint16_t u16_t;
 
+/**
+ * 32 bit datatype
+ *
+ * This typedef defines the 32-bit type used throughout uIP.
+ *
+ * \hideinitializer
+ */
+typedef uint32_t u32_t;
+
 /**
  * Statistics datatype
  *
@@ -99,6 +108,62 @@ typedef unsigned short uip_stats_t;
  */
 #define UIP_CONF_MAX_LISTENPORTS 40
 
+/**
+ * Number of buckets in the TCP connection hash table.
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_TCP_HASH_SIZE   32
+
+/**
+ * Number of buckets in the listening port hash table.
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_LISTEN_HASH_SIZE 16
+
+/**
+ * Native 32-bit TCP sequence numbers
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_TCP_SEQ32       1
+
+/**
+ * Header prediction for established TCP connections.
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_TCP_HDRPRED     1
+
+/**
+ * Number of segments in the shared TCP send queue pool.
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_TCP_SNDQ_SEGS   8
+
+/**
+ * Maximum number of segments in flight per TCP connection.
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_TCP_SNDWND_SEGS 4
+
+/**
+ * Number of segments in the shared TCP out-of-order queue pool.
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_TCP_OOQ_SEGS    8
+
+/**
+ * Advertised TCP receive window.
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_RECEIVE_WINDOW  (4 * UIP_TCP_MSS)
+
 /**
  * uIP buffer size.
  *
@@ -141,6 +206,94 @@ typedef unsigned short uip_stats_t;
  */
 #define UIP_CONF_STATISTICS      1
 
+/**
+ * Use the Cortex-M4 checksum functions in src/uip_arch.c instead of
+ * the generic ones in uip.c.
+ *
+ * \hideinitializer
+ */
+#define UIP_ARCH_CHKSUM          1
+
+/**
+ * Let the network driver sum incoming TCP segments while copying
+ * them, see nic_read().
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_RX_CHKSUM       1
+
+/**
+ * Split outgoing TCP segments for peers that delay their ACKs. The
+ * main loop sends IP packets through uip_split_output(), which sends
+ * the segments with nic_split_output().
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_SPLIT           UIP_SPLIT_ADAPTIVE
+#define UIP_SPLIT_CONF_OUTPUT    nic_split_output
+void nic_split_output(void);
+
+/**
+ * Retransmission timeout in milliseconds, serviced from the main
+ * loop. Since the segments are split for peers that delay their ACKs,
+ * the smallest timeout can be below the delayed ACK timeout.
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_TCP_FINE_RTO    1
+#define UIP_CONF_TCP_RTO_MIN     (CLOCK_SECOND / 50)
+
+/**
+ * TCP window scaling and timestamps.
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_TCP_WSCALE      1
+#define UIP_CONF_TCP_TIMESTAMPS  1
+
+/**
+ * Answer SYNs with SYN cookies when no more than a quarter of the
+ * connections are free. main() keys them from src/entropy.c.
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_TCP_SYNCOOKIES  1
+
+/**
+ * Number of connections in FIN_WAIT_2 or TIME_WAIT that are kept
+ * outside the connection table.
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_TCP_TW_CONNS    16
+
+/**
+ * Allocate the application state of TCP connections from memory
+ * block pools.
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_TCP_APPSTATE_POOL 1
+
+/**
+ * Keepalive probes on connections that have been idle for two
+ * minutes, every ten seconds, and give up after five. The timer
+ * pulses are half a second.
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_TCP_KEEPIDLE    240
+#define UIP_CONF_TCP_KEEPINTVL   20
+#define UIP_CONF_TCP_KEEPCNT     5
+
+/**
+ * Evict the connection that has been idle the longest, if for at
+ * least a minute, when a new connection arrives to a full table.
+ *
+ * \hideinitializer
+ */
+#define UIP_CONF_TCP_EVICT_IDLE  120
+
 /* Here we include the header file for the application(s) we use in
    our project. */
 /*#include "smtp.h"*/
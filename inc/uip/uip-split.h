@@ -48,15 +48,17 @@
  * maximum achievable throughput for sending data from uIP.
  *
  * The uip-split module is a hack which tries to remedy this
- * situation. By splitting maximum sized outgoing TCP segments into
- * two, the delayed ACK algorithm is not invoked at TCP
- * receivers. This improves the throughput when sending data from uIP
- * by orders of magnitude.
+ * situation. By splitting outgoing TCP segments into two, the delayed
+ * ACK algorithm is not invoked at TCP receivers. This improves the
+ * throughput when sending data from uIP by orders of magnitude.
  *
- * The uip-split module uses the uip-fw module (uIP IP packet
- * forwarding) for sending packets. Therefore, the uip-fw module must
- * be set up with the appropriate network interfaces for this module
- * to work.
+ * Which segments are split is set with the UIP_SPLIT configuration
+ * option. With UIP_SPLIT_ADAPTIVE, only connections whose peer has
+ * been seen to delay its ACKs get their segments split.
+ *
+ * By default the uip-split module uses the uip-fw module (uIP IP
+ * packet forwarding) for sending packets. Another output function
+ * can be given with UIP_SPLIT_CONF_OUTPUT.
  */
 
 
@@ -72,20 +74,33 @@
 #ifndef __UIP_SPLIT_H__
 #define __UIP_SPLIT_H__
 
+/**
+ * The function that sends out each of the packets.
+ *
+ * It is called with the packet in uip_buf and its length, without
+ * the link level header, in uip_len.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_SPLIT_CONF_OUTPUT
+#define UIP_SPLIT_OUTPUT UIP_SPLIT_CONF_OUTPUT
+#else /* UIP_SPLIT_CONF_OUTPUT */
+#define UIP_SPLIT_OUTPUT uip_fw_output
+#endif /* UIP_SPLIT_CONF_OUTPUT */
+
 /**
  * Handle outgoing packets.
  *
  * This function inspects an outgoing packet in the uip_buf buffer and
- * sends it out using the uip_fw_output() function. If the packet is a
- * full-sized TCP segment it will be split into two segments and
- * transmitted separately. This function should be called instead of
- * the actual device driver output function, or the uip_fw_output()
- * function.
+ * sends it out using the UIP_SPLIT_OUTPUT() function. If the packet
+ * is a TCP data segment that should be split according to UIP_SPLIT,
+ * it will be split into two segments and transmitted separately. This
+ * function should be called instead of the actual device driver
+ * output function, or the uip_fw_output() function.
  *
- * The headers of the outgoing packet is assumed to be in the uip_buf
- * buffer and the payload is assumed to be wherever uip_appdata
- * points. The length of the outgoing packet is assumed to be in the
- * uip_len variable.
+ * The outgoing packet is assumed to be in the uip_buf buffer, with
+ * the payload directly after the TCP header. The length of the
+ * outgoing packet is assumed to be in the uip_len variable.
  *
  */
 void uip_split_output(void);
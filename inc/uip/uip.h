@@ -323,6 +323,19 @@ void uip_setipid(u16_t id);
 #define uip_periodic_conn(conn) do { uip_conn = conn; \
                                      uip_process(UIP_TIMER); } while (0)
 
+#if UIP_TCP_TW_CONNS
+/**
+ * Periodic processing for the FIN_WAIT_2 and TIME_WAIT connections.
+ *
+ * With UIP_TCP_TW_CONNS, these connections are kept apart from
+ * uip_conns, and uip_periodic() does not see them. This function ages
+ * them, and should be called once each time the periodic uIP timer
+ * goes off, in addition to uip_periodic() for the connections. It
+ * never leaves a packet in the uIP packet buffer.
+ */
+void uip_tw_periodic(void);
+#endif /* UIP_TCP_TW_CONNS */
+
 /**
  * Reuqest that a particular connection should be polled.
  *
@@ -337,6 +350,114 @@ void uip_setipid(u16_t id);
 #define uip_poll_conn(conn) do { uip_conn = conn; \
                                  uip_process(UIP_POLL_REQUEST); } while (0)
 
+/**
+ * Request that a connection should be polled as soon as possible.
+ *
+ * This macro marks a connection as having new data to send. Instead
+ * of waiting for the next periodic timer, the main loop should check
+ * uip_poll_requested() and call uip_poll_conn() for every connection
+ * for which uip_poll_pending() is true. This function can be called
+ * both from application code and from interrupt handlers.
+ *
+ \code
+  if(uip_poll_requested()) {
+    for(i = 0; i < UIP_CONNS; ++i) {
+      if(uip_poll_pending(&uip_conns[i])) {
+        uip_poll_conn(&uip_conns[i]);
+        if(uip_len > 0) {
+          uip_arp_out();
+          ethernet_devicedriver_send();
+        }
+      }
+    }
+  }
+ \endcode
+ *
+ * \note If the connection still has unacknowledged data when it is
+ * polled, the request is ignored. The application will be invoked
+ * anyway when the outstanding data is acknowledged.
+ *
+ * \param conn A pointer to the uip_conn struct for the connection to
+ * be polled.
+ *
+ * \hideinitializer
+ */
+#define uip_request_poll(conn) do { (conn)->pollreq = 1; \
+                                    uip_pollreqs = 1; } while (0)
+
+/**
+ * Check and clear the global poll request flag.
+ *
+ * \return Non-zero if any connection has requested to be polled
+ * since the last call.
+ *
+ * \hideinitializer
+ */
+#define uip_poll_requested() (uip_pollreqs != 0 && \
+                              (uip_pollreqs = 0, 1))
+
+/**
+ * Check and clear the poll request of a connection.
+ *
+ * \param conn A pointer to the uip_conn struct for the connection.
+ *
+ * \return Non-zero if the connection had a pending poll request.
+ *
+ * \hideinitializer
+ */
+#define uip_poll_pending(conn) ((conn)->pollreq != 0 && \
+                                ((conn)->pollreq = 0, 1))
+
+#if UIP_TCP_FINE_RTO
+/**
+ * Retransmit on a connection whose retransmission timer has expired.
+ *
+ * With UIP_TCP_FINE_RTO, the retransmission timers are kept in clock
+ * ticks and expire between the periodic timer pulses. The main loop
+ * should check uip_rexmit_due() every time around and call
+ * uip_rexmit_conn() for every connection for which
+ * uip_rexmit_pending() is true:
+ *
+ \code
+  if(uip_rexmit_due()) {
+    for(i = 0; i < UIP_CONNS; ++i) {
+      if(uip_rexmit_pending(&uip_conns[i])) {
+        uip_rexmit_conn(&uip_conns[i]);
+        if(uip_len > 0) {
+          uip_arp_out();
+          ethernet_devicedriver_send();
+        }
+      }
+    }
+  }
+ \endcode
+ *
+ * Expired timers are also found by uip_periodic(), only later.
+ *
+ * \param conn A pointer to the uip_conn struct for the connection.
+ *
+ * \hideinitializer
+ */
+#define uip_rexmit_conn(conn) do { uip_conn = conn; \
+                                   uip_process(UIP_REXMIT_TIMER); } while (0)
+
+/**
+ * Check if a retransmission timer may have expired.
+ *
+ * \return Non-zero if the earliest retransmission timer has been
+ * reached since the last call.
+ */
+u8_t uip_rexmit_due(void);
+
+/**
+ * Check if the retransmission timer of a connection has expired.
+ *
+ * \param conn A pointer to the uip_conn struct for the connection.
+ */
+struct uip_conn;
+u8_t uip_rexmit_pending(struct uip_conn *conn);
+#endif /* UIP_TCP_FINE_RTO */
+
 
 #if UIP_UDP
 /**
@@ -468,11 +589,14 @@ void uip_unlisten(u16_t port);
  *
  * This function is used to start a new connection to the specified
  * port on the specied host. It allocates a new connection identifier,
- * sets the connection to the SYN_SENT state and sets the
- * retransmission timer to 0. This will cause a TCP SYN segment to be
- * sent out the next time this connection is periodically processed,
- * which usually is done within 0.5 seconds after the call to
- * uip_connect().
+ * sets the connection to the SYN_SENT state and requests that the
+ * connection is polled with uip_request_poll(). The TCP SYN segment
+ * is sent out when the main loop services the poll request with
+ * uip_poll_conn(), so the connection takes one round-trip time to
+ * establish. If the main loop does not service poll requests, the
+ * SYN is sent out the next time this connection is periodically
+ * processed, which usually is done within 0.5 seconds after the call
+ * to uip_connect().
  *
  * \note This function is avaliable only if support for active open
  * has been configured by defining UIP_ACTIVE_OPEN to 1 in uipopt.h.
@@ -497,6 +621,48 @@ void uip_unlisten(u16_t port);
  */
 struct uip_conn *uip_connect(uip_ipaddr_t *ripaddr, u16_t port);
 
+#if UIP_TCP_APPSTATE_POOL
+/**
+ * Allocate the application state of a connection.
+ *
+ * With UIP_TCP_APPSTATE_POOL, this function allocates a block from a
+ * pool declared with MEMB() and makes it the appstate of the
+ * connection. The block is returned to the pool by uIP when the
+ * connection is closed, aborted or timed out, after the application
+ * has been told. A connection has no application state until this
+ * function has been called for it, and its appstate is NULL.
+ *
+ \code
+ MEMB(states, struct httpd_state, 8);
+
+ void
+ httpd_appcall(void)
+ {
+   struct httpd_state *s;
+
+   if(uip_connected()) {
+     if(uip_appstate_alloc(uip_conn, &states) == NULL) {
+       uip_abort();
+       return;
+     }
+   }
+   s = uip_conn->appstate;
+   if(s == NULL) {
+     return;
+   }
+   ...
+ \endcode
+ *
+ * \param conn A pointer to the uip_conn struct for the connection.
+ *
+ * \param m The pool to allocate the block from.
+ *
+ * \return A pointer to the block, or NULL if the pool is empty.
+ */
+struct memb_blocks;
+void *uip_appstate_alloc(struct uip_conn *conn, struct memb_blocks *m);
+#endif /* UIP_TCP_APPSTATE_POOL */
+
 
 
 /**
@@ -643,6 +809,12 @@ void uip_send(const void *data, int len);
  * acknowledged by the remote host. This means that the application
  * can send new data.
  *
+ * When the TCP send queue is used (UIP_TCP_SNDQ_SEGS is non-zero),
+ * this instead means that the data has been accepted into the send
+ * queue, and uIP takes care of any retransmissions. The application
+ * is polled shortly after each send to learn this, so that it can
+ * keep several segments in flight.
+ *
  * \hideinitializer
  */
 #define uip_acked()   (uip_flags & UIP_ACKDATA)
@@ -697,6 +869,10 @@ void uip_send(const void *data, int len);
  * application should send the exact same data as it did the last
  * time, using the uip_send() function.
  *
+ * When the TCP send queue is used, this means that the data could
+ * not be accepted because the queue was full, and that there now is
+ * room for it.
+ *
  * \hideinitializer
  */
 #define uip_rexmit()     (uip_flags & UIP_REXMIT)
@@ -1133,6 +1309,22 @@ extern void *uip_urgdata;
  */
 extern u16_t uip_len;
 
+#if UIP_RX_CHKSUM
+/**
+ * The sum of the IP payload of the packet in uip_buf, computed by the
+ * device driver.
+ *
+ * If UIP_RX_CHKSUM is set, a device driver that sums the packet while
+ * copying it may store the 16-bit one's complement sum of everything
+ * after the IP header, in host byte order, in uip_rxsum and set
+ * uip_rxsum_valid. uIP then only adds the pseudo header to check the
+ * TCP checksum. The driver must set or clear uip_rxsum_valid for every
+ * packet it reads; uIP clears it when the sum has been used.
+ */
+extern u16_t uip_rxsum;
+extern u8_t uip_rxsum_valid;
+#endif /* UIP_RX_CHKSUM */
+
 /** @} */
 
 #if UIP_URGDATA > 0
@@ -1157,27 +1349,100 @@ struct uip_conn {
   u16_t rport;        /**< The local remote TCP port, in network byte
 			 order. */
   
+#if UIP_TCP_SEQ32
+  u32_t rcv_nxt;      /**< The sequence number that we expect to
+			 receive next, in host byte order. */
+  u32_t snd_nxt;      /**< The sequence number that was last sent by
+                         us, in host byte order. */
+#else /* UIP_TCP_SEQ32 */
   u8_t rcv_nxt[4];    /**< The sequence number that we expect to
 			 receive next. */
   u8_t snd_nxt[4];    /**< The sequence number that was last sent by
                          us. */
+#endif /* UIP_TCP_SEQ32 */
   u16_t len;          /**< Length of the data that was previously sent. */
   u16_t mss;          /**< Current maximum segment size for the
 			 connection. */
   u16_t initialmss;   /**< Initial maximum segment size for the
 			 connection. */
+#if UIP_TCP_FINE_RTO
+  u16_t sa;           /**< Smoothed round-trip time, in clock ticks
+			 times eight. */
+  u16_t sv;           /**< Round-trip time variation, in clock ticks
+			 times four. */
+  u16_t rto;          /**< Retransmission time-out, in clock ticks. */
+  u32_t rtx_time;     /**< The time at which the retransmission timer
+			 expires. */
+  u16_t rtt_time;     /**< The time at which the timed segment was
+			 sent. */
+  u16_t rtt_left;     /**< Bytes that must be acknowledged before the
+			 timed segment is, or zero if no segment is
+			 being timed. */
+#else /* UIP_TCP_FINE_RTO */
   u8_t sa;            /**< Retransmission time-out calculation state
 			 variable. */
   u8_t sv;            /**< Retransmission time-out calculation state
 			 variable. */
   u8_t rto;           /**< Retransmission time-out. */
+#endif /* UIP_TCP_FINE_RTO */
   u8_t tcpstateflags; /**< TCP state and flags. */
-  u8_t timer;         /**< The retransmission timer. */
+  u8_t timer;         /**< The retransmission timer, or the time spent
+			 in TIME_WAIT. */
   u8_t nrtx;          /**< The number of retransmissions for the last
 			 segment sent. */
-
+  volatile u8_t pollreq; /**< Set by uip_request_poll(). */
+#if UIP_TCP_WSCALE || UIP_TCP_TIMESTAMPS
+  u8_t tcpopts;       /**< The TCP options in use, and the window
+			 scale of the peer in the low four bits. */
+#endif /* UIP_TCP_WSCALE || UIP_TCP_TIMESTAMPS */
+#if UIP_TCP_TIMESTAMPS
+  u32_t ts_recent;    /**< The last timestamp of the peer, echoed in
+			 our segments. */
+#endif /* UIP_TCP_TIMESTAMPS */
+  struct uip_conn *hnext; /**< Next connection in the same hash
+			     bucket. */
+#if UIP_TCP_SNDQ
+  struct uip_sndseg *sndq; /**< Sent but unacknowledged segments,
+			      oldest first. */
+  u16_t snd_wnd;      /**< The window advertised by the peer. */
+  u8_t sndq_nxt;      /**< The number of segments in the send queue
+			 that have been sent. */
+  u8_t sndflags;      /**< Send queue state flags. */
+  u8_t cwnd;          /**< Congestion window, in segments. */
+  u8_t ssthresh;      /**< Slow start threshold, in segments. */
+  u8_t cwndacc;       /**< ACKs counted towards the next congestion
+			 window increase in congestion avoidance. */
+  u8_t dupacks;       /**< The number of duplicate ACKs in a row. */
+  u16_t recover;      /**< Bytes that must be acknowledged to end
+			 fast recovery. */
+#endif /* UIP_TCP_SNDQ */
+#if UIP_TCP_OOQ
+  struct uip_ooseg *ooq; /**< Segments received out of order, in
+			    sequence number order. */
+#endif /* UIP_TCP_OOQ */
+#if UIP_SPLIT == UIP_SPLIT_ADAPTIVE
+  u16_t sndtime;      /**< The time at which the outstanding data was
+			 sent or last partly acknowledged. */
+  u8_t delack;        /**< Non-zero if the peer has been seen to
+			 delay its ACKs. */
+#endif /* UIP_SPLIT == UIP_SPLIT_ADAPTIVE */
+#if UIP_TCP_KEEPALIVE || UIP_TCP_EVICT_IDLE
+  u16_t idle;         /**< Timer pulses since a segment was last
+			 received from the peer. */
+#endif /* UIP_TCP_KEEPALIVE || UIP_TCP_EVICT_IDLE */
+#if UIP_TCP_KEEPALIVE
+  u8_t kaprobes;      /**< The number of unanswered keepalive
+			 probes. */
+#endif /* UIP_TCP_KEEPALIVE */
+
+#if UIP_TCP_APPSTATE_POOL
+  void *appstate;     /**< The application state, allocated with
+			 uip_appstate_alloc(), or NULL. */
+  struct memb_blocks *apppool; /**< The pool of appstate. */
+#else /* UIP_TCP_APPSTATE_POOL */
   /** The application state. */
   uip_tcp_appstate_t appstate;
+#endif /* UIP_TCP_APPSTATE_POOL */
 };
 
 
@@ -1190,6 +1455,28 @@ struct uip_conn {
 extern struct uip_conn *uip_conn;
 /* The array containing all uIP connections. */
 extern struct uip_conn uip_conns[UIP_CONNS];
+/* Non-zero if any connection has a pending poll request. */
+extern volatile u8_t uip_pollreqs;
+#if UIP_TCP_SYNCOOKIES
+/**
+ * The secret that SYN cookies are keyed with.
+ *
+ * This should be set to a random value at startup. Anyone who knows
+ * it can open connections from spoofed addresses when SYN cookies
+ * are in use.
+ */
+extern u32_t uip_syncookie_secret;
+#endif /* UIP_TCP_SYNCOOKIES */
+#if UIP_ACTIVE_OPEN
+/**
+ * The key that the local ports of uip_connect() are chosen with.
+ *
+ * This should be set to a random value before uip_init() is
+ * called. Anyone who knows it can predict the local ports of new
+ * connections.
+ */
+extern u32_t uip_portkey;
+#endif /* UIP_ACTIVE_OPEN */
 /**
  * \addtogroup uiparch
  * @{
@@ -1271,6 +1558,23 @@ struct uip_stats {
 			     connections was avaliable. */
     uip_stats_t synrst;   /**< Number of SYNs for closed ports,
 			     triggering a RST. */
+    uip_stats_t predhit;  /**< Number of TCP segments that took the
+			     header prediction fast path. */
+    uip_stats_t ooseg;    /**< Number of TCP segments that were
+			     received out of order and queued. */
+    uip_stats_t fastrexmit; /**< Number of fast retransmissions on
+			     duplicate ACKs. */
+    uip_stats_t cwndcut;  /**< Number of times the congestion window
+			     was reduced. */
+    uip_stats_t paws;     /**< Number of TCP segments dropped for
+			     an old timestamp. */
+    uip_stats_t cookiesent; /**< Number of SYNs answered with a SYN
+			     cookie. */
+    uip_stats_t cookiebad; /**< Number of ACKs for a listening port
+			     without a valid SYN cookie. */
+    uip_stats_t keepalive; /**< Number of keepalive probes sent. */
+    uip_stats_t evicted;  /**< Number of idle connections aborted to
+			     make room for a new one. */
   } tcp;                  /**< TCP statistics. */
 #if UIP_UDP
   struct {
@@ -1367,6 +1671,10 @@ void uip_process(u8_t flag);
 #if UIP_UDP
 #define UIP_UDP_TIMER     5
 #endif /* UIP_UDP */
+#if UIP_TCP_FINE_RTO
+#define UIP_REXMIT_TIMER  6     /* Tells uIP that the retransmission
+				   timer of a connection has expired. */
+#endif /* UIP_TCP_FINE_RTO */
 
 /* The TCP states used in the uip_conn->tcpstateflags. */
 #define UIP_CLOSED      0
@@ -1594,6 +1902,29 @@ u16_t uip_tcpchksum(void);
  */
 u16_t uip_udpchksum(void);
 
+/**
+ * Update a checksum for a changed 16-bit word.
+ *
+ * This function updates an Internet checksum incrementally, as
+ * described in RFC1624, when a 16-bit word that is covered by the
+ * checksum changes from oldval to newval. This is much cheaper than
+ * computing the checksum over the whole packet again. A block of data
+ * that is removed from the checksummed area can be handled by passing
+ * its uip_chksum() as oldval and zero as newval.
+ *
+ * All three values must be in the same byte order, typically network
+ * byte order as they are stored in the packet.
+ *
+ * \param chksum The checksum field of the packet.
+ *
+ * \param oldval The old value of the word.
+ *
+ * \param newval The new value of the word.
+ *
+ * \return The updated checksum field.
+ */
+u16_t uip_chksum_adjust(u16_t chksum, u16_t oldval, u16_t newval);
+
 
 #endif /* __UIP_H__ */
 
@@ -232,6 +232,34 @@
  */
 #define UIP_ACTIVE_OPEN 1
 
+/**
+ * The first local port used for connections opened with
+ * uip_connect().
+ *
+ * A local port may be used for several connections, as long as they
+ * are to different remote ports or hosts. Listening ports should be
+ * kept outside of the range.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_PORT_MIN
+#define UIP_TCP_PORT_MIN UIP_CONF_TCP_PORT_MIN
+#else /* UIP_CONF_TCP_PORT_MIN */
+#define UIP_TCP_PORT_MIN 4096
+#endif /* UIP_CONF_TCP_PORT_MIN */
+
+/**
+ * The last local port used for connections opened with
+ * uip_connect().
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_PORT_MAX
+#define UIP_TCP_PORT_MAX UIP_CONF_TCP_PORT_MAX
+#else /* UIP_CONF_TCP_PORT_MAX */
+#define UIP_TCP_PORT_MAX 31999
+#endif /* UIP_CONF_TCP_PORT_MAX */
+
 /**
  * The maximum number of simultaneously open TCP connections.
  *
@@ -261,6 +289,35 @@
 #define UIP_LISTENPORTS UIP_CONF_MAX_LISTENPORTS
 #endif /* UIP_CONF_MAX_LISTENPORTS */
 
+/**
+ * The number of buckets in the TCP connection hash table.
+ *
+ * Incoming segments are matched with their connection through a hash
+ * on the remote IP address and the port pair, so that the lookup does
+ * not get slower as UIP_CONNS grows. Must be a power of two. Each
+ * bucket requires one pointer of memory.
+ *
+ * \hideinitializer
+ */
+#ifndef UIP_CONF_TCP_HASH_SIZE
+#define UIP_TCP_HASH_SIZE 16
+#else /* UIP_CONF_TCP_HASH_SIZE */
+#define UIP_TCP_HASH_SIZE UIP_CONF_TCP_HASH_SIZE
+#endif /* UIP_CONF_TCP_HASH_SIZE */
+
+/**
+ * The number of buckets in the listening port hash table.
+ *
+ * Must be a power of two. Each bucket requires one byte of memory.
+ *
+ * \hideinitializer
+ */
+#ifndef UIP_CONF_LISTEN_HASH_SIZE
+#define UIP_LISTEN_HASH_SIZE 8
+#else /* UIP_CONF_LISTEN_HASH_SIZE */
+#define UIP_LISTEN_HASH_SIZE UIP_CONF_LISTEN_HASH_SIZE
+#endif /* UIP_CONF_LISTEN_HASH_SIZE */
+
 /**
  * Determines if support for TCP urgent data notification should be
  * compiled in.
@@ -296,6 +353,98 @@
  */
 #define UIP_MAXSYNRTX      5
 
+/**
+ * Answer SYNs with SYN cookies when the connection table is nearly
+ * full.
+ *
+ * If this is set and no more than UIP_TCP_SYNCOOKIE_THRESHOLD
+ * connections are CLOSED or in TIME_WAIT, a SYN to a listening port
+ * does not take a connection. Instead, the SYNACK carries a sequence
+ * number that encodes the connection and the MSS of the peer, and the
+ * connection is created when the ACK for it arrives. Window scaling
+ * and timestamps are not offered in such a SYNACK.
+ *
+ * The cookies are keyed by uip_syncookie_secret.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_SYNCOOKIES
+#define UIP_TCP_SYNCOOKIES UIP_CONF_TCP_SYNCOOKIES
+#else /* UIP_CONF_TCP_SYNCOOKIES */
+#define UIP_TCP_SYNCOOKIES 0
+#endif /* UIP_CONF_TCP_SYNCOOKIES */
+
+/**
+ * The number of free connections at or below which SYN cookies are
+ * used.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_SYNCOOKIE_THRESHOLD
+#define UIP_TCP_SYNCOOKIE_THRESHOLD UIP_CONF_TCP_SYNCOOKIE_THRESHOLD
+#else /* UIP_CONF_TCP_SYNCOOKIE_THRESHOLD */
+#define UIP_TCP_SYNCOOKIE_THRESHOLD (UIP_CONNS / 4)
+#endif /* UIP_CONF_TCP_SYNCOOKIE_THRESHOLD */
+
+/**
+ * Determines if the retransmission timeout should be kept in clock
+ * ticks instead of timer pulses.
+ *
+ * With this option, the round-trip time of a segment is measured
+ * with clock_time() and the retransmission timer of a connection is
+ * a deadline of its own, which the main loop can check with
+ * uip_rexmit_due() between the periodic timer pulses. Without it, no
+ * retransmission timeout can be shorter than UIP_RTO timer pulses.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_FINE_RTO
+#define UIP_TCP_FINE_RTO UIP_CONF_TCP_FINE_RTO
+#else /* UIP_CONF_TCP_FINE_RTO */
+#define UIP_TCP_FINE_RTO 0
+#endif /* UIP_CONF_TCP_FINE_RTO */
+
+/**
+ * The initial retransmission timeout, in clock ticks.
+ *
+ * Only used if UIP_TCP_FINE_RTO is set.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_RTO_INIT
+#define UIP_TCP_RTO_INIT UIP_CONF_TCP_RTO_INIT
+#else /* UIP_CONF_TCP_RTO_INIT */
+#define UIP_TCP_RTO_INIT CLOCK_SECOND
+#endif /* UIP_CONF_TCP_RTO_INIT */
+
+/**
+ * The smallest retransmission timeout, in clock ticks.
+ *
+ * Only used if UIP_TCP_FINE_RTO is set. It keeps the timeout above
+ * the time it takes the peer to send a delayed ACK.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_RTO_MIN
+#define UIP_TCP_RTO_MIN UIP_CONF_TCP_RTO_MIN
+#else /* UIP_CONF_TCP_RTO_MIN */
+#define UIP_TCP_RTO_MIN (CLOCK_SECOND / 5)
+#endif /* UIP_CONF_TCP_RTO_MIN */
+
+/**
+ * The largest retransmission timeout, in clock ticks, including the
+ * exponential backoff.
+ *
+ * Only used if UIP_TCP_FINE_RTO is set. It must fit in 16 bits.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_RTO_MAX
+#define UIP_TCP_RTO_MAX UIP_CONF_TCP_RTO_MAX
+#else /* UIP_CONF_TCP_RTO_MAX */
+#define UIP_TCP_RTO_MAX (60 * CLOCK_SECOND)
+#endif /* UIP_CONF_TCP_RTO_MAX */
+
 /**
  * The TCP maximum segment size.
  *
@@ -319,6 +468,186 @@
 #define UIP_RECEIVE_WINDOW UIP_CONF_RECEIVE_WINDOW
 #endif
 
+/**
+ * Negotiate TCP window scaling (RFC 7323).
+ *
+ * If this is set, our SYNs offer window scaling, and the window
+ * advertised by a peer that agrees to it is scaled. Our own window
+ * is never scaled, since UIP_RECEIVE_WINDOW must fit in 16 bits
+ * anyway, but the option must be sent for the peer to be allowed to
+ * scale its window.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_WSCALE
+#define UIP_TCP_WSCALE UIP_CONF_TCP_WSCALE
+#else /* UIP_CONF_TCP_WSCALE */
+#define UIP_TCP_WSCALE 0
+#endif /* UIP_CONF_TCP_WSCALE */
+
+/**
+ * Negotiate TCP timestamps (RFC 7323).
+ *
+ * If this is set, our SYNs offer timestamps, and every segment on a
+ * connection that agrees to them carries a timestamp option, which
+ * takes 12 bytes from the MSS. Segments with an old timestamp are
+ * dropped (PAWS). With UIP_TCP_FINE_RTO, the echoed timestamps give
+ * an RTT sample for every acknowledgement, also of retransmitted
+ * data.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_TIMESTAMPS
+#define UIP_TCP_TIMESTAMPS UIP_CONF_TCP_TIMESTAMPS
+#else /* UIP_CONF_TCP_TIMESTAMPS */
+#define UIP_TCP_TIMESTAMPS 0
+#endif /* UIP_CONF_TCP_TIMESTAMPS */
+
+/**
+ * Header prediction for established TCP connections.
+ *
+ * If this is set, an incoming segment is first checked against the
+ * connection that received the previous segment. If it is the next
+ * in-sequence segment on an established connection and carries
+ * nothing but an ACK, possibly data and, with UIP_TCP_TIMESTAMPS, a
+ * timestamp option in the usual layout, the connection lookup and the
+ * generic header checks are skipped.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_HDRPRED
+#define UIP_TCP_HDRPRED UIP_CONF_TCP_HDRPRED
+#else /* UIP_CONF_TCP_HDRPRED */
+#define UIP_TCP_HDRPRED 0
+#endif /* UIP_CONF_TCP_HDRPRED */
+
+/**
+ * Keep TCP sequence numbers as native 32-bit integers.
+ *
+ * If this is set, the sequence numbers in struct uip_conn are u32_t
+ * in host byte order and are converted only when they are read from
+ * or written to a TCP header. This is faster on 32-bit CPUs than the
+ * default byte arrays in network byte order, and the packets sent are
+ * the same.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_SEQ32
+#define UIP_TCP_SEQ32 UIP_CONF_TCP_SEQ32
+#else /* UIP_CONF_TCP_SEQ32 */
+#define UIP_TCP_SEQ32 0
+#endif /* UIP_CONF_TCP_SEQ32 */
+
+/**
+ * Split outgoing TCP segments in two to avoid delayed ACKs.
+ *
+ * A TCP receiver that delays its ACKs waits up to 200 ms before
+ * acknowledging a lone segment, which stalls a sender that has only
+ * one segment in flight. If this is set to UIP_SPLIT_ALWAYS, every
+ * outgoing TCP data segment is sent as two segments by
+ * uip_split_output(). If it is set to UIP_SPLIT_ADAPTIVE, only the
+ * segments of connections whose peer has been seen to delay its ACKs
+ * are split. If it is zero, segments are never split.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_SPLIT
+#define UIP_SPLIT UIP_CONF_SPLIT
+#else /* UIP_CONF_SPLIT */
+#define UIP_SPLIT 0
+#endif /* UIP_CONF_SPLIT */
+
+#define UIP_SPLIT_ALWAYS   1
+#define UIP_SPLIT_ADAPTIVE 2
+
+/**
+ * The ACK delay, in clock ticks, above which a peer is taken to delay
+ * its ACKs.
+ *
+ * Only used if UIP_SPLIT is UIP_SPLIT_ADAPTIVE. It should be larger
+ * than the round-trip time to the peers, but below the smallest
+ * delayed ACK timeout in use (40 ms for Linux).
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_SPLIT_DELACK_TIME
+#define UIP_SPLIT_DELACK_TIME UIP_CONF_SPLIT_DELACK_TIME
+#else /* UIP_CONF_SPLIT_DELACK_TIME */
+#define UIP_SPLIT_DELACK_TIME (CLOCK_SECOND / 40)
+#endif /* UIP_CONF_SPLIT_DELACK_TIME */
+
+/**
+ * The number of segments in the shared TCP send queue pool.
+ *
+ * If this is non-zero, uIP keeps a copy of each data segment it sends
+ * until the segment has been acknowledged, so that a connection can
+ * have several segments in flight and retransmissions are made from
+ * the queue instead of by the application. Each segment requires
+ * UIP_TCP_MSS bytes plus a few bytes of overhead. The pool is shared
+ * between all connections.
+ *
+ * If this is zero, a connection has at most one segment in flight and
+ * the application regenerates the data on retransmission.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_SNDQ_SEGS
+#define UIP_TCP_SNDQ_SEGS UIP_CONF_TCP_SNDQ_SEGS
+#else /* UIP_CONF_TCP_SNDQ_SEGS */
+#define UIP_TCP_SNDQ_SEGS 0
+#endif /* UIP_CONF_TCP_SNDQ_SEGS */
+
+/**
+ * Non-zero if the TCP send queue is compiled in.
+ *
+ * \hideinitializer
+ */
+#define UIP_TCP_SNDQ (UIP_TCP_SNDQ_SEGS > 0)
+
+/**
+ * The maximum number of segments a connection may have in flight.
+ *
+ * Only used when the send queue is compiled in (UIP_TCP_SNDQ_SEGS is
+ * non-zero). Within this limit, the number of segments in flight is
+ * governed by the congestion window of the connection, which is
+ * opened by slow start and congestion avoidance and halved on loss.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_SNDWND_SEGS
+#define UIP_TCP_SNDWND_SEGS UIP_CONF_TCP_SNDWND_SEGS
+#else /* UIP_CONF_TCP_SNDWND_SEGS */
+#define UIP_TCP_SNDWND_SEGS 4
+#endif /* UIP_CONF_TCP_SNDWND_SEGS */
+
+/**
+ * The number of segments in the shared TCP out-of-order queue pool.
+ *
+ * If this is non-zero, a segment that arrives ahead of the next
+ * expected one, but within the advertised window, is kept until the
+ * missing data has arrived instead of being dropped. It is then
+ * delivered to the application as new data when the connection is
+ * polled. Each segment requires UIP_TCP_MSS bytes plus a few bytes of
+ * overhead. The pool is shared between all connections.
+ *
+ * The queue is only of use if UIP_RECEIVE_WINDOW is larger than one
+ * MSS.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_OOQ_SEGS
+#define UIP_TCP_OOQ_SEGS UIP_CONF_TCP_OOQ_SEGS
+#else /* UIP_CONF_TCP_OOQ_SEGS */
+#define UIP_TCP_OOQ_SEGS 0
+#endif /* UIP_CONF_TCP_OOQ_SEGS */
+
+/**
+ * Non-zero if the TCP out-of-order queue is compiled in.
+ *
+ * \hideinitializer
+ */
+#define UIP_TCP_OOQ (UIP_TCP_OOQ_SEGS > 0)
+
 /**
  * How long a connection should stay in the TIME_WAIT state.
  *
@@ -327,6 +656,125 @@
  */
 #define UIP_TIME_WAIT_TIMEOUT 120
 
+/**
+ * The number of connections in FIN_WAIT_2 or TIME_WAIT that are kept
+ * apart from the connections in uip_conns.
+ *
+ * Such a connection only needs its addresses, ports and sequence
+ * numbers to acknowledge the segments of the peer. If this is set,
+ * it is moved to a table of its own when the application has closed
+ * it and the peer has acknowledged the FIN, and its connection in
+ * uip_conns can be used again right away. The application is told
+ * that the connection is closed at that point. When the table is
+ * full, the oldest entry is dropped. The entries time out after
+ * UIP_TIME_WAIT_TIMEOUT calls to uip_tw_periodic().
+ *
+ * If this is zero, the connections stay in uip_conns until they time
+ * out.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_TW_CONNS
+#define UIP_TCP_TW_CONNS UIP_CONF_TCP_TW_CONNS
+#else /* UIP_CONF_TCP_TW_CONNS */
+#define UIP_TCP_TW_CONNS 0
+#endif /* UIP_CONF_TCP_TW_CONNS */
+
+/**
+ * Keep the application state of TCP connections in memory block
+ * pools instead of in uip_conn.
+ *
+ * If this is set, the appstate field of uip_conn is a pointer to a
+ * block that the application allocates with uip_appstate_alloc(),
+ * typically when uip_connected() is true, from a pool declared with
+ * MEMB(). Applications on different ports can use pools of
+ * differently sized blocks. uIP returns the block to its pool when
+ * the connection is closed, aborted or timed out, after the
+ * application has been told.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_APPSTATE_POOL
+#define UIP_TCP_APPSTATE_POOL UIP_CONF_TCP_APPSTATE_POOL
+#else /* UIP_CONF_TCP_APPSTATE_POOL */
+#define UIP_TCP_APPSTATE_POOL 0
+#endif /* UIP_CONF_TCP_APPSTATE_POOL */
+
+/**
+ * The number of timer pulses a connection may be idle before uIP
+ * starts to send keepalive probes on it.
+ *
+ * A connection is idle when nothing has been received from the peer
+ * and no data is outstanding. If this is non-zero, a keepalive probe
+ * is sent on an ESTABLISHED connection when it has been idle for this
+ * many calls to uip_periodic(), and then every UIP_TCP_KEEPINTVL
+ * calls until the peer answers. When UIP_TCP_KEEPCNT probes have
+ * gone unanswered, the connection is aborted and the application is
+ * told that it has timed out.
+ *
+ * UIP_TCP_KEEPIDLE + UIP_TCP_KEEPCNT * UIP_TCP_KEEPINTVL must be less
+ * than 65535.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_KEEPIDLE
+#define UIP_TCP_KEEPIDLE UIP_CONF_TCP_KEEPIDLE
+#else /* UIP_CONF_TCP_KEEPIDLE */
+#define UIP_TCP_KEEPIDLE 0
+#endif /* UIP_CONF_TCP_KEEPIDLE */
+
+/**
+ * The number of timer pulses between keepalive probes.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_KEEPINTVL
+#define UIP_TCP_KEEPINTVL UIP_CONF_TCP_KEEPINTVL
+#else /* UIP_CONF_TCP_KEEPINTVL */
+#define UIP_TCP_KEEPINTVL 150
+#endif /* UIP_CONF_TCP_KEEPINTVL */
+
+/**
+ * The number of unanswered keepalive probes after which a connection
+ * is aborted.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_KEEPCNT
+#define UIP_TCP_KEEPCNT UIP_CONF_TCP_KEEPCNT
+#else /* UIP_CONF_TCP_KEEPCNT */
+#define UIP_TCP_KEEPCNT 9
+#endif /* UIP_CONF_TCP_KEEPCNT */
+
+/**
+ * Non-zero if TCP keepalive is compiled in.
+ *
+ * \hideinitializer
+ */
+#define UIP_TCP_KEEPALIVE (UIP_TCP_KEEPIDLE > 0)
+
+/**
+ * The number of timer pulses a connection must have been idle before
+ * it may be evicted to make room for a new connection.
+ *
+ * If this is non-zero and a new connection arrives when there are no
+ * unused connections, the ESTABLISHED connection that has been idle
+ * the longest, if for at least this many calls to uip_periodic(), is
+ * aborted and used for the new connection. The application is told
+ * that the evicted connection was aborted. The peer of the evicted
+ * connection gets a reset when it next sends something.
+ *
+ * If this is zero, new connections are dropped when there are no
+ * unused connections.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_EVICT_IDLE
+#define UIP_TCP_EVICT_IDLE UIP_CONF_TCP_EVICT_IDLE
+#else /* UIP_CONF_TCP_EVICT_IDLE */
+#define UIP_TCP_EVICT_IDLE 0
+#endif /* UIP_CONF_TCP_EVICT_IDLE */
+
 
 /** @} */
 /*------------------------------------------------------------------------------*/
@@ -448,6 +896,22 @@ void uip_log(char *msg);
 #define UIP_LLH_LEN     14
 #endif /* UIP_CONF_LLH_LEN */
 
+/**
+ * Let the device driver sum incoming TCP segments.
+ *
+ * If this is set, a device driver that computes the checksum of the
+ * packet while copying it into uip_buf can hand the sum of the IP
+ * payload to uIP in uip_rxsum, and uIP then checks the TCP checksum
+ * without reading the segment again.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_RX_CHKSUM
+#define UIP_RX_CHKSUM UIP_CONF_RX_CHKSUM
+#else /* UIP_CONF_RX_CHKSUM */
+#define UIP_RX_CHKSUM 0
+#endif /* UIP_CONF_RX_CHKSUM */
+
 /** @} */
 /*------------------------------------------------------------------------------*/
 /**
@@ -38,13 +38,39 @@
  *         Adam Dunkels <adam@sics.se>
  */
 
-#include "clock-arch.h"
-#include <sys/time.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "clock.h"
+#include "etimer.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/systick.h"
 
+static volatile clock_time_t ticks;
+
+/*---------------------------------------------------------------------------*/
+void
+clock_init(void)
+{
+    /* SysTick fires CLOCK_SECOND times per second. */
+    SysTickPeriodSet(SysCtlClockGet() / CLOCK_SECOND);
+    SysTickIntEnable();
+    SysTickEnable();
+}
+/*---------------------------------------------------------------------------*/
+void
+clock_isr(void)
+{
+    ++ticks;
+    /* Wake the event timer process when the next timer is due. */
+    if(etimer_pending() &&
+       !CLOCK_LT(ticks, etimer_next_expiration_time())) {
+        etimer_request_poll();
+    }
+}
 /*---------------------------------------------------------------------------*/
 clock_time_t
 clock_time(void)
 {
-    return 0;
+    return ticks;
 }
 /*---------------------------------------------------------------------------*/
@@ -1,8 +1,11 @@
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "enc28j60.h"
 #include "driverlib/hw_memmap.h"
+#include "driverlib/hw_ints.h"
 #include "driverlib/gpio.h"
+#include "driverlib/interrupt.h"
 #include "driverlib/ssi.h"
 #include "driverlib/sysctl.h"
 
@@ -132,6 +135,9 @@ static void write_control_register(struct ENC28J60 *enc28j60, uint8_t reg, uint8
 static uint16_t read_phy_register(struct ENC28J60 *enc28j60, uint8_t phy_addr);
 static void write_phy_register(struct ENC28J60 *enc28j60, uint8_t phy_addr, int16_t value);
 static void read_buffer_memory(struct ENC28J60 *enc28j60, uint8_t *data, uint16_t bytes);
+static void read_buffer_memory_sum(struct ENC28J60 *enc28j60, uint8_t *data, uint16_t bytes,
+                                   uint16_t offset, uint32_t *sum);
+static uint16_t read_frame(struct ENC28J60 *enc28j60, uint8_t *data, uint16_t offset, uint32_t *sum);
 static void write_buffer_memory(struct ENC28J60 *enc28j60, uint8_t *data, uint16_t bytes);
 static void bit_field_set(struct ENC28J60 *enc28j60, uint8_t reg, uint8_t bitfield);
 static void bit_field_clear(struct ENC28J60 *enc28j60, uint8_t reg, uint8_t bitfield);
@@ -158,6 +164,7 @@ struct ENC28J60 ENC28J60 = {
     GPIO_PIN_1,
     GPIO_PORTB_BASE,
     GPIO_PIN_0,
+    INT_GPIOB_TM4C123,
     enc28j60_rx_buffer,
     enc28j60_tx_buffer,
     0
@@ -214,6 +221,18 @@ void ENC28J60_enable_interrupts(struct ENC28J60 *enc28j60) {
     bit_field_set(enc28j60, EIE, 0x80);
 }
 
+/* The INT pin is held low for as long as an enabled interrupt flag is
+    set, so the GPIO interrupt is level triggered and masked by the handler
+    until the pending frames have been read. */
+void ENC28J60_enable_int_pin(struct ENC28J60 *enc28j60) {
+    GPIOIntEnable(enc28j60->intr_pin_base, enc28j60->intr_pin);
+}
+
+void ENC28J60_disable_int_pin(struct ENC28J60 *enc28j60) {
+    GPIOIntDisable(enc28j60->intr_pin_base, enc28j60->intr_pin);
+    GPIOIntClear(enc28j60->intr_pin_base, enc28j60->intr_pin);
+}
+
 uint8_t ENC28J60_get_interrupt_requests(struct ENC28J60 *enc28j60) {
     return read_control_register(enc28j60, EIR, 1);
 }
@@ -223,6 +242,20 @@ void ENC28J60_decrement_packet_count(struct ENC28J60 *enc28j60) {
 }
 
 uint16_t ENC28J60_read_frame_blocking(struct ENC28J60 *enc28j60, uint8_t *data) {
+    return read_frame(enc28j60, data, 0, NULL);
+}
+
+/* Read a frame like ENC28J60_read_frame_blocking() and, while copying
+ * it, sum the bytes from offset to the end of the frame as big endian
+ * 16-bit words. The sum is not folded, and it includes the CRC at the
+ * end of the frame. The CPU would only be waiting for the SPI
+ * transfer in the meantime, so the sum comes for free. */
+uint16_t ENC28J60_read_frame_sum(struct ENC28J60 *enc28j60, uint8_t *data,
+                                 uint16_t offset, uint32_t *sum) {
+    return read_frame(enc28j60, data, offset, sum);
+}
+
+static uint16_t read_frame(struct ENC28J60 *enc28j60, uint8_t *data, uint16_t offset, uint32_t *sum) {
     uint16_t len;
     uint8_t next_frame[2];
     uint8_t rsv[4];
@@ -232,6 +265,10 @@ uint16_t ENC28J60_read_frame_blocking(struct ENC28J60 *enc28j60, uint8_t *data)
     bit_field_clear(enc28j60, ECON1, 3); // switch to bank 0
     bit_field_set(enc28j60, ECON1, 0);
 
+    /* Not summed unless the frame is read below. */
+    if (sum != NULL)
+        *sum = 0;
+
     read_buffer_memory(enc28j60, next_frame, 2);
     read_buffer_memory(enc28j60, rsv, 4);
 
@@ -243,7 +280,10 @@ uint16_t ENC28J60_read_frame_blocking(struct ENC28J60 *enc28j60, uint8_t *data)
         return len;
     }
 
-    read_buffer_memory(enc28j60, data, len);
+    if (sum != NULL)
+        read_buffer_memory_sum(enc28j60, data, len, offset, sum);
+    else
+        read_buffer_memory(enc28j60, data, len);
 
     write_control_register(enc28j60, ERXRDPTL, next_frame[0]);
     write_control_register(enc28j60, ERXRDPTH, next_frame[1]);
@@ -493,6 +533,32 @@ static void read_buffer_memory(struct ENC28J60 *enc28j60, uint8_t *data, uint16_
     GPIOPinWrite(enc28j60->cs_pin_base, enc28j60->cs_pin, enc28j60->cs_pin);
 }
 
+static void read_buffer_memory_sum(struct ENC28J60 *enc28j60, uint8_t *data, uint16_t bytes,
+                                   uint16_t offset, uint32_t *sum) {
+    uint8_t cmd = RBM_OPCODE | RBM_ARG0;
+    uint32_t tmp;
+    uint32_t acc = 0;
+    int i;
+    GPIOPinWrite(enc28j60->cs_pin_base, enc28j60->cs_pin, 0);
+    SSIDataPut(enc28j60->ssi_base, cmd);
+    SSIDataGet(enc28j60->ssi_base, &tmp);
+    for (i = 0; i < bytes && i < offset; i++) {
+        SSIDataPut(enc28j60->ssi_base, NOP);
+        SSIDataGet(enc28j60->ssi_base, &tmp);
+        data[i] = tmp;
+    }
+    /* Even bytes from offset are the high bytes of the words. A frame
+     * is too short for the 32-bit sum to overflow. */
+    for (; i < bytes; i++) {
+        SSIDataPut(enc28j60->ssi_base, NOP);
+        SSIDataGet(enc28j60->ssi_base, &tmp);
+        data[i] = tmp;
+        acc += ((i - offset) & 1) ? (tmp & 0xFF) : (tmp & 0xFF) << 8;
+    }
+    GPIOPinWrite(enc28j60->cs_pin_base, enc28j60->cs_pin, enc28j60->cs_pin);
+    *sum = acc;
+}
+
 static void write_buffer_memory(struct ENC28J60 *enc28j60, uint8_t *data, uint16_t bytes) {
     uint32_t trash;
     uint8_t cmd = WBM_OPCODE | WBM_ARG0;
@@ -570,6 +636,8 @@ static void init_peripherals(struct ENC28J60 *enc28j60) {
     GPIOPinWrite(enc28j60->cs_pin_base, enc28j60->cs_pin, enc28j60->cs_pin);
 
     GPIOPinTypeGPIOInput(enc28j60->intr_pin_base, enc28j60->intr_pin);
+    GPIOIntTypeSet(enc28j60->intr_pin_base, enc28j60->intr_pin, GPIO_LOW_LEVEL);
+    IntEnable(enc28j60->intr_int);
 }
 
 static void init_buffers(struct ENC28J60 *enc28j60) {
@@ -0,0 +1,86 @@
+/*
+ * Seed material for the keys of the TCP stack, gathered at start-up.
+ *
+ * The TM4C123 has no random number generator. The readings of the
+ * on-chip temperature sensor have a few bits of noise at the bottom,
+ * so we take a number of them and hash them together, along with the
+ * SysTick counter at each reading. This is not a cryptographic
+ * source, but it keeps the keys from being the same, or guessable
+ * from the time since reset, on every boot.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "entropy.h"
+#include "driverlib/adc.h"
+#include "driverlib/hw_memmap.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/systick.h"
+
+/* Number of temperature sensor readings per call. */
+#define ENTROPY_SAMPLES 64
+
+#define ENTROPY_SEQ 3
+
+static uint32_t pool;
+
+/*---------------------------------------------------------------------------*/
+static void
+mix(uint32_t v)
+{
+    pool = (pool ^ v) * 0x01000193;
+    pool = (pool << 13) | (pool >> 19);
+}
+/*---------------------------------------------------------------------------*/
+static void
+sample(void)
+{
+    uint32_t v;
+    int i;
+
+    for(i = 0; i < ENTROPY_SAMPLES; ++i) {
+        ADCProcessorTrigger(ADC0_BASE, ENTROPY_SEQ);
+        while(!ADCIntStatus(ADC0_BASE, ENTROPY_SEQ, false)) {
+        }
+        ADCIntClear(ADC0_BASE, ENTROPY_SEQ);
+        ADCSequenceDataGet(ADC0_BASE, ENTROPY_SEQ, &v);
+        mix(v);
+        mix(SysTickValueGet());
+    }
+}
+/*---------------------------------------------------------------------------*/
+void
+entropy_init(void)
+{
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_ADC0);
+    while(!SysCtlPeripheralReady(SYSCTL_PERIPH_ADC0)) {
+    }
+    /* The PIOSC works whether or not the PLL is running. */
+    ADCClockConfigSet(ADC0_BASE, ADC_CLOCK_SRC_PIOSC | ADC_CLOCK_RATE_FULL, 1);
+    ADCSequenceConfigure(ADC0_BASE, ENTROPY_SEQ, ADC_TRIGGER_PROCESSOR, 0);
+    ADCSequenceStepConfigure(ADC0_BASE, ENTROPY_SEQ, 0,
+                             ADC_CTL_TS | ADC_CTL_IE | ADC_CTL_END);
+    ADCSequenceEnable(ADC0_BASE, ENTROPY_SEQ);
+    ADCIntClear(ADC0_BASE, ENTROPY_SEQ);
+
+    sample();
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+entropy_get(void)
+{
+    uint32_t h;
+
+    sample();
+
+    /* Spread the pool over all bits of the result (the MurmurHash3
+       finalizer), so that the pool itself is not given away. */
+    h = pool;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+/*---------------------------------------------------------------------------*/
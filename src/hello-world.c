@@ -26,6 +26,18 @@
 #include "uip.h"
 #include <string.h>
 
+#if UIP_TCP_APPSTATE_POOL
+#include "memb.h"
+
+/*
+ * The application states are allocated from a pool when a connection
+ * is established, so only this many connections can greet at once.
+ */
+#define HELLO_WORLD_CONNS 8
+
+MEMB(hello_world_states, struct hello_world_state, HELLO_WORLD_CONNS);
+#endif /* UIP_TCP_APPSTATE_POOL */
+
 /*
  * Declaration of the protosocket function that handles the connection
  * (defined at the end of the code).
@@ -40,6 +52,10 @@ static int handle_connection(struct hello_world_state *s);
 void
 hello_world_init(void)
 {
+#if UIP_TCP_APPSTATE_POOL
+  memb_init(&hello_world_states);
+#endif /* UIP_TCP_APPSTATE_POOL */
+
   /* We start to listen for connections on TCP port 1000. */
   uip_listen(HTONS(1000));
 }
@@ -54,19 +70,45 @@ hello_world_init(void)
 void
 hello_world_appcall(void)
 {
+  struct hello_world_state *s;
+
+#if UIP_TCP_APPSTATE_POOL
+  /*
+   * The uip_conn structure has a field called "appstate" that points
+   * to the application state of the connection. The state is
+   * allocated when the connection is established and uIP returns it
+   * to the pool when the connection is closed. If the pool is empty,
+   * we abort the connection.
+   */
+  if(uip_connected()) {
+    if(uip_appstate_alloc(uip_conn, &hello_world_states) == NULL) {
+      uip_abort();
+      return;
+    }
+  }
+  s = uip_conn->appstate;
+  if(s == NULL) {
+    return;
+  }
+#else /* UIP_TCP_APPSTATE_POOL */
   /*
    * The uip_conn structure has a field called "appstate" that holds
    * the application state of the connection. We make a pointer to
    * this to access it easier.
    */
-  struct hello_world_state *s = &(uip_conn->appstate);
+  s = &(uip_conn->appstate);
+#endif /* UIP_TCP_APPSTATE_POOL */
 
   /*
    * If a new connection was just established, we should initialize
-   * the protosocket in our applications' state structure.
+   * the protosocket in our applications' state structure. We read the
+   * name in place with PSOCK_PEEK(), so the protosocket needs no input
+   * buffer. The output buffer lets the replies below go out as one
+   * segment each.
    */
   if(uip_connected()) {
-    PSOCK_INIT(&s->p, s->inputbuffer, sizeof(s->inputbuffer));
+    PSOCK_INIT(&s->p, NULL, 0);
+    PSOCK_OUTBUF(&s->p, s->outputbuffer, sizeof(s->outputbuffer));
   }
 
   /*
@@ -86,13 +128,37 @@ hello_world_appcall(void)
 static int
 handle_connection(struct hello_world_state *s)
 {
+  u8_t *end;
+  u16_t len, n;
+
   PSOCK_BEGIN(&s->p);
 
-  PSOCK_SEND_STR(&s->p, "Hello. What is your name?\n");
-  PSOCK_READTO(&s->p, '\n');
-  strncpy(s->name, s->inputbuffer, sizeof(s->name));
-  PSOCK_SEND_STR(&s->p, "Hello ");
-  PSOCK_SEND_STR(&s->p, s->name);
+  PSOCK_WRITE_STR(&s->p, "Hello. What is your name?\n");
+
+  /*
+   * Read the name up to and including the newline, straight from the
+   * incoming segments. A name that does not fit is cut short, but is
+   * still read up to the newline.
+   */
+  s->namelen = 0;
+  do {
+    PSOCK_PEEK(&s->p);
+    len = PSOCK_PEEKLEN(&s->p);
+    end = memchr(PSOCK_PEEKPTR(&s->p), '\n', len);
+    if(end != NULL) {
+      len = end - PSOCK_PEEKPTR(&s->p) + 1;
+    }
+    n = sizeof(s->name) - s->namelen;
+    if(n > len) {
+      n = len;
+    }
+    memcpy(s->name + s->namelen, PSOCK_PEEKPTR(&s->p), n);
+    s->namelen += n;
+    PSOCK_CONSUME(&s->p, len);
+  } while(end == NULL);
+
+  PSOCK_WRITE_STR(&s->p, "Hello ");
+  PSOCK_WRITE(&s->p, s->name, s->namelen);
   PSOCK_CLOSE(&s->p);
   
   PSOCK_END(&s->p);
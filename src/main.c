@@ -3,8 +3,12 @@
 #include "uip.h"
 #include "uip_arp.h"
 #include "uip-fw.h"
+#include "uip-split.h"
 #include "timer.h"
+#include "process.h"
+#include "etimer.h"
 #include "nic.h"
+#include "entropy.h"
 
 #define BUF ((struct uip_eth_hdr *)&uip_buf[0])
 
@@ -12,14 +16,43 @@ void uip_log(char *m) {
     return;
 }
 
+/* Send the packet uIP left in uip_buf. uip_arp_out() puts an Ethernet
+ * header in front of an IP packet, or replaces it with an ARP request.
+ * With UIP_SPLIT, IP packets go through uip_split_output(), which may
+ * send a TCP segment as two frames through nic_split_output(). */
+static void ip_output(void) {
+    uip_arp_out();
+#if UIP_SPLIT
+    if(BUF->type == htons(UIP_ETHTYPE_IP)) {
+        uip_len -= UIP_LLH_LEN;
+        uip_split_output();
+        return;
+    }
+#endif /* UIP_SPLIT */
+    nic_write(uip_buf, uip_len);
+}
+
 int main(void){
     struct timer periodic_timer, arp_timer;
 
 
-    int i;
+    int i, budget;
     uip_ipaddr_t ipaddr;
     
+    clock_init();
+    entropy_init();
+    process_init();
+    process_start(&etimer_process, NULL);
     nic_init();
+
+#if UIP_TCP_SYNCOOKIES
+    /* A known key would let anyone forge the cookies. */
+    uip_syncookie_secret = entropy_get();
+#endif /* UIP_TCP_SYNCOOKIES */
+#if UIP_ACTIVE_OPEN
+    /* Nor should the local ports of new connections be predictable. */
+    uip_portkey = entropy_get();
+#endif /* UIP_ACTIVE_OPEN */
     uip_init();
     
     /* modify this per your LAN configuration */
@@ -32,9 +65,18 @@ int main(void){
 
     hello_world_init();
 
+    timer_set(&periodic_timer, CLOCK_SECOND / 2);
+    timer_set(&arp_timer, CLOCK_SECOND * 10);
+
     while(1) {
-        uip_len = nic_read(uip_buf);
-        if(uip_len > 0) {
+        /* Read at most NIC_RX_BUDGET frames before the timers and the
+        pending application sends get their turn, so that a flood of
+        incoming frames cannot starve retransmissions and polls. */
+        for(budget = NIC_RX_BUDGET; budget > 0 && nic_pending(); --budget) {
+            uip_len = nic_read(uip_buf);
+            if(uip_len == 0) {
+                continue;
+            }
             if(BUF->type == htons(UIP_ETHTYPE_IP)) {
                 uip_arp_ipin();
                 uip_input();
@@ -42,8 +84,7 @@ int main(void){
                 should be sent out on the network, the global variable
                 uip_len is set to a value > 0. */
                 if(uip_len > 0) {
-                    uip_arp_out();
-                    nic_write(uip_buf, uip_len);
+                    ip_output();
                 }
             } else if(BUF->type == htons(UIP_ETHTYPE_ARP)) {
                 uip_arp_arpin();
@@ -54,8 +95,10 @@ int main(void){
                     nic_write(uip_buf, uip_len);
                 }
             }
+        }
+        nic_poll_done(budget == 0);
 
-        } else if(timer_expired(&periodic_timer)) {
+        if(timer_expired(&periodic_timer)) {
             timer_reset(&periodic_timer);
             for(i = 0; i < UIP_CONNS; i++) {
                 uip_periodic(i);
@@ -63,10 +106,12 @@ int main(void){
                 should be sent out on the network, the global variable
                 uip_len is set to a value > 0. */
                 if(uip_len > 0) {
-                    uip_arp_out();
-                    nic_write(uip_buf, uip_len);
+                    ip_output();
                 }
             }
+#if UIP_TCP_TW_CONNS
+            uip_tw_periodic();
+#endif /* UIP_TCP_TW_CONNS */
 
 #if UIP_UDP
             for(i = 0; i < UIP_UDP_CONNS; i++) {
@@ -75,8 +120,7 @@ int main(void){
                 should be sent out on the network, the global variable
                 uip_len is set to a value > 0. */
                 if(uip_len > 0) {
-                    uip_arp_out();
-                    nic_write(uip_buf, uip_len);
+                    ip_output();
                 }
             }
 #endif /* UIP_UDP */
@@ -87,6 +131,37 @@ int main(void){
                 uip_arp_timer();
             }
         }
+
+        /* Give the protothread processes their turn. */
+        process_run();
+
+        /* Service connections that asked to be polled right away
+        instead of waiting for the periodic timer. */
+        if(uip_poll_requested()) {
+            for(i = 0; i < UIP_CONNS; i++) {
+                if(uip_poll_pending(&uip_conns[i])) {
+                    uip_poll_conn(&uip_conns[i]);
+                    if(uip_len > 0) {
+                        ip_output();
+                    }
+                }
+            }
+        }
+
+#if UIP_TCP_FINE_RTO
+        /* Retransmit as soon as a retransmission timer expires instead
+        of waiting for the periodic timer. */
+        if(uip_rexmit_due()) {
+            for(i = 0; i < UIP_CONNS; i++) {
+                if(uip_rexmit_pending(&uip_conns[i])) {
+                    uip_rexmit_conn(&uip_conns[i]);
+                    if(uip_len > 0) {
+                        ip_output();
+                    }
+                }
+            }
+        }
+#endif /* UIP_TCP_FINE_RTO */
     }
 }
 
@@ -6,11 +6,24 @@
 #define BUF ((struct uip_eth_hdr *)&uip_buf[0])
 #define ETH_SENDER_MAC_ADDR_OFFSET 6
 #define ARP_SENDER_HW_ADDR_OFFSET 22
+#define RX_CHKSUM_OFFSET (UIP_LLH_LEN + UIP_IPH_LEN)
+
+struct nic_stats nic_stats;
 
 static uint8_t mac[6];
 
 static struct ENC28J60 *pENC = &ENC28J60;
 
+/* The receive path is either in interrupt mode, where the INT pin
+ * interrupt tells us that frames are waiting and no SPI traffic is
+ * spent on checking, or in polling mode, where the interrupt is masked
+ * and the packet count is read until the NIC has been drained. We
+ * start out polling so that nic_read() works before nic_poll_done()
+ * has been called. */
+static volatile uint8_t int_pending;
+static uint8_t polling = 1;
+static uint8_t rx_pending;
+
 int nic_init(void) {
     if (!ENC28J60_init(pENC))
         return 0;
@@ -19,11 +32,67 @@ int nic_init(void) {
     return 0;
 }
 
+int nic_pending(void) {
+    if (!polling) {
+        if (!int_pending)
+            return 0;
+        int_pending = 0;
+        polling = 1;
+        nic_stats.poll_mode++;
+    }
+    if (rx_pending == 0)
+        rx_pending = ENC28J60_get_packet_count(pENC);
+    return rx_pending;
+}
+
+#if UIP_RX_CHKSUM
+/* The driver sums everything after the IP header while it copies the
+ * frame. If the frame is an unfragmented TCP segment we take the
+ * Ethernet CRC and any padding out of that sum again and hand it to
+ * uIP, which then does not have to read the segment a second time to
+ * check the TCP checksum. */
+static void rx_chksum(uint8_t *buf, int size, uint32_t sum) {
+    struct uip_tcpip_hdr *ip = (struct uip_tcpip_hdr *)&buf[UIP_LLH_LEN];
+    int i, end;
+
+    uip_rxsum_valid = 0;
+    if (size < UIP_LLH_LEN + UIP_IPTCPH_LEN ||
+        BUF->type != htons(UIP_ETHTYPE_IP) ||
+        ip->vhl != 0x45 || ip->proto != UIP_PROTO_TCP ||
+        (ip->ipoffset[0] & 0x3F) != 0 || ip->ipoffset[1] != 0)
+        return;
+    end = UIP_LLH_LEN + ((ip->len[0] << 8) | ip->len[1]);
+    if (end > size)
+        return;
+    for (i = end; i < size; i++)
+        sum -= ((i - RX_CHKSUM_OFFSET) & 1) ? buf[i] : buf[i] << 8;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    uip_rxsum = sum;
+    uip_rxsum_valid = 1;
+}
+#endif
+
 int nic_read(uint8_t *buf) {
     int size = 0;
-    if (ENC28J60_get_packet_count(pENC) > 0) {
+    if (nic_pending()) {
+#if UIP_RX_CHKSUM
+        uint32_t sum;
+        size = ENC28J60_read_frame_sum(pENC, buf, RX_CHKSUM_OFFSET, &sum);
+        /* On a receive error the driver returns a length beyond the
+         * largest frame without reading the frame, and buf still holds
+         * the previous one. uip_buf is smaller than the largest frame,
+         * so checking against it catches that too. */
+        if (size > UIP_BUFSIZE)
+            uip_rxsum_valid = 0;
+        else
+            rx_chksum(buf, size, sum);
+#else
         size = ENC28J60_read_frame_blocking(pENC, buf);
+#endif
         ENC28J60_decrement_packet_count(pENC);
+        rx_pending--;
+        nic_stats.rx_frames++;
     }
     return size;
 }
@@ -40,3 +109,32 @@ void nic_write(uint8_t *buf, int size) {
     ENC28J60_write_frame_blocking(pENC, buf, size);
 }
 
+#if UIP_SPLIT
+/* UIP_SPLIT_OUTPUT() for uip_split_output(), which leaves each packet
+ * in uip_buf behind the Ethernet header, with its IP length in
+ * uip_len. */
+void nic_split_output(void) {
+    nic_write(uip_buf, uip_len + UIP_LLH_LEN);
+}
+#endif
+
+/* Called by the main loop after each receive round. If the round ran
+ * out of budget there is more to read and we stay in polling mode,
+ * otherwise the NIC has been drained and we go back to waiting for the
+ * interrupt. */
+void nic_poll_done(int budget_exhausted) {
+    if (budget_exhausted) {
+        nic_stats.budget_exhausted++;
+        return;
+    }
+    if (polling && rx_pending == 0) {
+        polling = 0;
+        nic_stats.intr_mode++;
+        ENC28J60_enable_int_pin(pENC);
+    }
+}
+
+void nic_isr(void) {
+    ENC28J60_disable_int_pin(pENC);
+    int_pending = 1;
+}
@@ -8,6 +8,53 @@ void memcpy(void *dst, const void *src, int n) {
       *((char *) dst++) = *((char *) src++);
 }
 
+void memmove(void *dst, const void *src, int n) {
+    if ((char *) dst <= (char *) src) {
+        while (n--)
+          *((char *) dst++) = *((char *) src++);
+    } else {
+        while (n--)
+          ((char *) dst)[n] = ((char *) src)[n];
+    }
+}
+
+typedef unsigned int __attribute__((__may_alias__)) word_t;
+
+/*
+ * Scans a word at a time once s is aligned. XORing a word with c in
+ * every byte turns the matching bytes into zero bytes, and
+ * (w - 0x01010101) & ~w & 0x80808080 is non-zero if and only if w has
+ * a zero byte.
+ */
+void *memchr(const void *s, int c, int n) {
+    const unsigned char *p = s;
+    unsigned char ch = c;
+    word_t mask, w;
+
+    while (n && ((unsigned long) p & (sizeof(word_t) - 1))) {
+        if (*p == ch)
+          return (void *) p;
+        p++;
+        n--;
+    }
+
+    mask = ch * 0x01010101U;
+    while (n >= (int) sizeof(word_t)) {
+        w = *((const word_t *) p) ^ mask;
+        if ((w - 0x01010101U) & ~w & 0x80808080U)
+          break;
+        p += sizeof(word_t);
+        n -= sizeof(word_t);
+    }
+
+    while (n--) {
+        if (*p == ch)
+          return (void *) p;
+        p++;
+    }
+    return 0;
+}
+
 int strlen(char *s) {
     int n = 0;
     while (*s++)
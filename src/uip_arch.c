@@ -0,0 +1,172 @@
+/*
+ * Checksum functions for the Cortex-M4, used instead of the generic
+ * ones in uip.c when UIP_ARCH_CHKSUM is set.
+ *
+ * The generic chksum() builds every 16-bit word from two byte loads
+ * and checks for a carry after each addition. Here the data is summed
+ * a 32-bit word at a time in the byte order of the CPU, and the
+ * carries are folded back in only once at the end. The one's
+ * complement sum does not depend on the byte order, except that the
+ * result comes out byte swapped (RFC 1071), which is fixed up by
+ * swapping the folded sum.
+ */
+
+#include <stdint.h>
+#include "uip.h"
+#include "uip_arch.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error uip_arch.c assumes a little endian CPU
+#endif
+
+#if UIP_ARCH_CHKSUM
+
+#define BUF ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+/*---------------------------------------------------------------------------*/
+/* Sum len bytes at data and add the result to sum. Both sum and the
+   return value are in host byte order, as for the generic chksum(). */
+static u16_t
+chksum(u16_t sum, const u8_t *data, u16_t len)
+{
+  uint64_t acc;
+  u32_t acc32;
+  const u32_t *p;
+  u8_t odd;
+
+  acc = 0;
+  odd = (uintptr_t)data & 1;
+
+  /* Sum a leading odd byte on its own so that the rest is aligned.
+     The rest of the data is then paired one byte off from the
+     checksum words, which makes its little endian sum come out in
+     host byte order instead of swapped. The first byte is the high
+     byte of its word. */
+  if(odd && len > 0) {
+    acc = (u16_t)data[0] << 8;
+    ++data;
+    --len;
+  }
+
+  if(((uintptr_t)data & 2) && len >= 2) {
+    acc += *(const u16_t *)data;
+    data += 2;
+    len -= 2;
+  }
+
+  /* The bulk of the data, 32 bytes at a time. */
+  p = (const u32_t *)data;
+  acc32 = 0;
+  while(len >= 32) {
+#if defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_7M__)
+    /* Two four-word loads with the carry chained through all eight
+       additions and added back in once. */
+    __asm__ volatile("ldmia %1!, {r2, r3, r4, r5}\n\t"
+		     "adds  %0, %0, r2\n\t"
+		     "adcs  %0, %0, r3\n\t"
+		     "adcs  %0, %0, r4\n\t"
+		     "adcs  %0, %0, r5\n\t"
+		     "ldmia %1!, {r2, r3, r4, r5}\n\t"
+		     "adcs  %0, %0, r2\n\t"
+		     "adcs  %0, %0, r3\n\t"
+		     "adcs  %0, %0, r4\n\t"
+		     "adcs  %0, %0, r5\n\t"
+		     "adc   %0, %0, #0\n\t"
+		     : "+r" (acc32), "+r" (p)
+		     :
+		     : "r2", "r3", "r4", "r5", "cc", "memory");
+#else
+    /* The 64-bit accumulator cannot overflow for the 16-bit lengths
+       used by uIP. */
+    acc += (uint64_t)p[0] + p[1] + p[2] + p[3] +
+      p[4] + p[5] + p[6] + p[7];
+    p += 8;
+#endif
+    len -= 32;
+  }
+  acc += acc32;
+
+  while(len >= 4) {
+    acc += *p++;
+    len -= 4;
+  }
+
+  data = (const u8_t *)p;
+  if(len >= 2) {
+    acc += *(const u16_t *)data;
+    data += 2;
+    len -= 2;
+  }
+  if(len > 0) {
+    /* A trailing byte is the first byte of its word. */
+    acc += data[0];
+  }
+
+  /* Fold the carries back into 16 bits. */
+  acc = (acc & 0xffffffff) + (acc >> 32);
+  acc = (acc & 0xffffffff) + (acc >> 32);
+  acc = (acc & 0xffff) + (acc >> 16);
+  acc = (acc & 0xffff) + (acc >> 16);
+  acc = (acc & 0xffff) + (acc >> 16);
+
+  if(!odd) {
+    acc = ((acc & 0xff) << 8) | (acc >> 8);
+  }
+
+  acc += sum;
+  acc = (acc & 0xffff) + (acc >> 16);
+  return (u16_t)acc;
+}
+/*---------------------------------------------------------------------------*/
+u16_t
+uip_chksum(u16_t *data, u16_t len)
+{
+  return htons(chksum(0, (u8_t *)data, len));
+}
+/*---------------------------------------------------------------------------*/
+u16_t
+uip_ipchksum(void)
+{
+  u16_t sum;
+
+  sum = chksum(0, &uip_buf[UIP_LLH_LEN], UIP_IPH_LEN);
+  return (sum == 0) ? 0xffff : htons(sum);
+}
+/*---------------------------------------------------------------------------*/
+static u16_t
+upper_layer_chksum(u8_t proto)
+{
+  u16_t upper_layer_len;
+  u16_t sum;
+
+  upper_layer_len = (((u16_t)(BUF->len[0]) << 8) + BUF->len[1]) - UIP_IPH_LEN;
+
+  /* First sum pseudoheader. */
+
+  /* IP protocol and length fields. This addition cannot carry. */
+  sum = upper_layer_len + proto;
+  /* Sum IP source and destination addresses. */
+  sum = chksum(sum, (u8_t *)&BUF->srcipaddr[0], 2 * sizeof(uip_ipaddr_t));
+
+  /* Sum TCP header and data. */
+  sum = chksum(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN],
+	       upper_layer_len);
+
+  return (sum == 0) ? 0xffff : htons(sum);
+}
+/*---------------------------------------------------------------------------*/
+u16_t
+uip_tcpchksum(void)
+{
+  return upper_layer_chksum(UIP_PROTO_TCP);
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_UDP_CHECKSUMS
+u16_t
+uip_udpchksum(void)
+{
+  return upper_layer_chksum(UIP_PROTO_UDP);
+}
+#endif /* UIP_UDP_CHECKSUMS */
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_ARCH_CHKSUM */
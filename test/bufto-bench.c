@@ -0,0 +1,167 @@
+/*
+ * Checks buf_bufto() in uip/psock.c, which finds the end marker with
+ * memchr() and copies with memcpy(), against the byte-at-a-time loop
+ * it replaced, over random segments, buffer sizes and alignments.
+ * Then times both on a segment of 80-byte lines.
+ *
+ * psock.c is built into this file so that the static buf_bufto() can
+ * be called, and it uses the memchr() and memcpy() of src/stdlib.c,
+ * as it does on the board, rather than those of the host C library.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define memset fw_memset
+#define memcpy fw_memcpy
+#define memmove fw_memmove
+#define memchr fw_memchr
+#define strlen fw_strlen
+#define strncpy fw_strncpy
+#define printf fw_printf
+#include "../src/stdlib.c"
+#include "../uip/psock.c"
+#undef memset
+#undef memcpy
+#undef memmove
+#undef memchr
+#undef strlen
+#undef strncpy
+#undef printf
+
+/* What psock.c needs from uip.c. */
+void *uip_appdata;
+struct uip_conn *uip_conn;
+u16_t uip_len;
+u8_t uip_flags;
+
+void
+uip_send(const void *data, int len)
+{
+}
+/*---------------------------------------------------------------------------*/
+/* buf_bufto() as it was before it used memchr(). */
+static u8_t
+ref_bufto(register struct psock_buf *buf, u8_t endmarker,
+	  register u8_t **dataptr, register u16_t *datalen)
+{
+  u8_t c;
+  while(buf->left > 0 && *datalen > 0) {
+    c = *buf->ptr = **dataptr;
+    ++*dataptr;
+    ++buf->ptr;
+    --*datalen;
+    --buf->left;
+
+    if(c == endmarker) {
+      return BUF_FOUND;
+    }
+  }
+
+  if(*datalen == 0) {
+    return BUF_NOT_FOUND;
+  }
+
+  while(*datalen > 0) {
+    c = **dataptr;
+    --*datalen;
+    ++*dataptr;
+
+    if(c == endmarker) {
+      return BUF_FOUND | BUF_FULL;
+    }
+  }
+
+  return BUF_FULL;
+}
+/*---------------------------------------------------------------------------*/
+static double
+now(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+/*---------------------------------------------------------------------------*/
+#define SEGLEN   366
+#define LINELEN  80
+#define BUFLEN   128
+#define ROUNDS   100000
+
+static u8_t data[UIP_BUFSIZE + 4];
+static u8_t refbuf[UIP_BUFSIZE], bufbuf[UIP_BUFSIZE];
+
+static double
+bench(u8_t (*f)(struct psock_buf *, u8_t, u8_t **, u16_t *))
+{
+  struct psock_buf buf;
+  volatile unsigned int sum;
+  u8_t *ptr;
+  u16_t len;
+  double t;
+  int i;
+
+  sum = 0;
+  t = now();
+  for(i = 0; i < ROUNDS; i++) {
+    ptr = data;
+    len = SEGLEN;
+    while(len > 0) {
+      buf.ptr = refbuf;
+      buf.left = BUFLEN;
+      sum += f(&buf, '\n', &ptr, &len);
+    }
+  }
+  return (now() - t) / ROUNDS * 1e9;
+}
+/*---------------------------------------------------------------------------*/
+int
+main(void)
+{
+  struct psock_buf ref, buf;
+  u8_t *refptr, *ptr;
+  u16_t reflen, len, size;
+  u8_t refret, ret;
+  int i, j, off;
+
+  srand(1);
+  for(i = 0; i < 200000; i++) {
+    off = i & 3;
+    len = rand() % 400;
+    size = rand() % 100;
+    /* Mostly no marker, sometimes many, sometimes none at all. */
+    for(j = 0; j < len; j++) {
+      data[off + j] = "abc\n"[rand() % ((i & 4)? 3: 4)];
+    }
+    memset(refbuf, 0, sizeof(refbuf));
+    memset(bufbuf, 0, sizeof(bufbuf));
+    ref.ptr = refbuf;
+    ref.left = size;
+    buf.ptr = bufbuf;
+    buf.left = size;
+    refptr = ptr = data + off;
+    reflen = len;
+
+    refret = ref_bufto(&ref, '\n', &refptr, &reflen);
+    ret = buf_bufto(&buf, '\n', &ptr, &len);
+
+    if(ret != refret || ptr != refptr || len != reflen ||
+       buf.left != ref.left || buf.ptr - bufbuf != ref.ptr - refbuf ||
+       memcmp(bufbuf, refbuf, sizeof(refbuf)) != 0) {
+      printf("bufto-bench: case %d (off %d size %u) returned %u, expected %u\n",
+	     i, off, size, ret, refret);
+      return 1;
+    }
+  }
+  printf("bufto-bench: %d segments ok\n", i);
+
+  for(i = 0; i < SEGLEN; i++) {
+    data[i] = i % LINELEN == LINELEN - 1? '\n': 'x';
+  }
+  printf("bufto-bench: %d-byte lines, old %.1f ns, new %.1f ns per segment\n",
+	 LINELEN, bench(ref_bufto), bench(buf_bufto));
+  return 0;
+}
@@ -0,0 +1,276 @@
+/**
+ * \addtogroup etimer
+ * @{
+ */
+
+/**
+ * \file
+ * Event timer library implementation.
+ */
+
+/*
+ * Copyright (c) 2004, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the uIP TCP/IP stack
+ *
+ * Author: Adam Dunkels <adam@sics.se>
+ *
+ */
+
+#include "etimer.h"
+
+/* The list of active timers and the time at which the first of them
+   expires. */
+static struct etimer *timerlist;
+static clock_time_t next_expiration;
+
+PROCESS(etimer_process, "Event timer");
+/*---------------------------------------------------------------------------*/
+static void
+update_time(void)
+{
+  struct etimer *t;
+
+  if(timerlist == NULL) {
+    next_expiration = 0;
+  } else {
+    t = timerlist;
+    next_expiration = t->timer.start + t->timer.interval;
+    for(t = t->next; t != NULL; t = t->next) {
+      if(CLOCK_LT(t->timer.start + t->timer.interval, next_expiration)) {
+	next_expiration = t->timer.start + t->timer.interval;
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(etimer_process, ev, data)
+{
+  struct etimer *t, *u;
+
+  PROCESS_BEGIN();
+
+  timerlist = NULL;
+
+  while(1) {
+    PROCESS_YIELD();
+
+    if(ev == PROCESS_EVENT_EXITED) {
+      /* Drop the timers of a process that has exited. */
+      struct process *p = data;
+
+      while(timerlist != NULL && timerlist->p == p) {
+	timerlist = timerlist->next;
+      }
+      if(timerlist != NULL) {
+	t = timerlist;
+	while(t->next != NULL) {
+	  if(t->next->p == p) {
+	    t->next = t->next->next;
+	  } else {
+	    t = t->next;
+	  }
+	}
+      }
+      update_time();
+      continue;
+    } else if(ev != PROCESS_EVENT_POLL) {
+      continue;
+    }
+
+  again:
+    u = NULL;
+    for(t = timerlist; t != NULL; t = t->next) {
+      if(timer_expired(&t->timer)) {
+	if(process_post(t->p, PROCESS_EVENT_TIMER, t) == PROCESS_ERR_OK) {
+	  /* A timer with no process is an expired timer. */
+	  t->p = PROCESS_NONE;
+	  if(u != NULL) {
+	    u->next = t->next;
+	  } else {
+	    timerlist = t->next;
+	  }
+	  t->next = NULL;
+	  update_time();
+	  goto again;
+	} else {
+	  /* The event queue is full; try again on the next run. */
+	  etimer_request_poll();
+	}
+      }
+      u = t;
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Make the event timer process check for expired timers.
+ *
+ * This function is safe to call from an interrupt handler and is
+ * typically called by the clock driver when the time returned by
+ * etimer_next_expiration_time() has been reached.
+ */
+void
+etimer_request_poll(void)
+{
+  process_poll(&etimer_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_timer(struct etimer *timer)
+{
+  struct etimer *t;
+
+  etimer_request_poll();
+
+  if(timer->p != PROCESS_NONE) {
+    /* The timer is already on the list, just update its owner. */
+    for(t = timerlist; t != NULL; t = t->next) {
+      if(t == timer) {
+	t->p = PROCESS_CURRENT();
+	update_time();
+	return;
+      }
+    }
+  }
+
+  timer->p = PROCESS_CURRENT();
+  timer->next = timerlist;
+  timerlist = timer;
+
+  update_time();
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Set an event timer.
+ *
+ * The timer posts a PROCESS_EVENT_TIMER event to the calling process
+ * when it expires.
+ *
+ * \param et A pointer to the event timer.
+ * \param interval The interval before the timer expires.
+ */
+void
+etimer_set(struct etimer *et, clock_time_t interval)
+{
+  timer_set(&et->timer, interval);
+  add_timer(et);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Reset an event timer with the same interval.
+ *
+ * Like timer_reset(), the new interval starts when the timer last
+ * expired, so a periodic event timer does not drift.
+ *
+ * \param et A pointer to the event timer.
+ */
+void
+etimer_reset(struct etimer *et)
+{
+  timer_reset(&et->timer);
+  add_timer(et);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Restart an event timer from the current point in time.
+ *
+ * \param et A pointer to the event timer.
+ */
+void
+etimer_restart(struct etimer *et)
+{
+  timer_restart(&et->timer);
+  add_timer(et);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Check if an event timer has expired.
+ *
+ * \param et A pointer to the event timer.
+ *
+ * \return Non-zero if the timer has expired or has been stopped.
+ */
+int
+etimer_expired(struct etimer *et)
+{
+  return et->p == PROCESS_NONE;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Stop a pending event timer.
+ *
+ * The timer is removed from the list of active timers and will not
+ * post an event.
+ *
+ * \param et A pointer to the event timer.
+ */
+void
+etimer_stop(struct etimer *et)
+{
+  struct etimer *t;
+
+  if(et == timerlist) {
+    timerlist = timerlist->next;
+    update_time();
+  } else {
+    for(t = timerlist; t != NULL && t->next != et; t = t->next);
+    if(t != NULL) {
+      t->next = et->next;
+      update_time();
+    }
+  }
+
+  et->next = NULL;
+  et->p = PROCESS_NONE;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Check if there are any active event timers.
+ */
+int
+etimer_pending(void)
+{
+  return timerlist != NULL;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Get the time at which the next event timer expires.
+ *
+ * Only meaningful when etimer_pending() returns non-zero.
+ */
+clock_time_t
+etimer_next_expiration_time(void)
+{
+  return etimer_pending() ? next_expiration : 0;
+}
+/*---------------------------------------------------------------------------*/
+
+/** @} */
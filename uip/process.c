@@ -0,0 +1,399 @@
+/**
+ * \addtogroup process
+ * @{
+ */
+
+/**
+ * \file
+ * Implementation of the protothread process scheduler.
+ */
+
+/*
+ * Copyright (c) 2005, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the uIP TCP/IP stack
+ *
+ * Author: Adam Dunkels <adam@sics.se>
+ *
+ */
+
+#include "process.h"
+
+#if (PROCESS_NUMEVENTS & (PROCESS_NUMEVENTS - 1)) != 0
+#error PROCESS_NUMEVENTS must be a power of two
+#endif
+
+#define PROCESS_STATE_NONE        0
+#define PROCESS_STATE_RUNNING     1
+#define PROCESS_STATE_CALLED      2
+
+struct process *process_list = NULL;
+struct process *process_current = NULL;
+
+static process_event_t lastevent;
+
+/*
+ * The event queue is a ring buffer of PROCESS_NUMEVENTS entries;
+ * fevent is the index of the oldest event and nevents the number of
+ * queued events.
+ */
+struct event_data {
+  process_event_t ev;
+  process_data_t data;
+  struct process *p;
+};
+
+static process_num_events_t nevents, fevent;
+static struct event_data events[PROCESS_NUMEVENTS];
+
+/* Set from process_poll(), which may be called from interrupts. */
+static volatile unsigned char poll_requested;
+
+/*---------------------------------------------------------------------------*/
+/**
+ * Allocate a global event number.
+ *
+ * Event numbers below 128 are left to the application, and 128 to
+ * PROCESS_EVENT_TIMER are used by the system. This function hands out
+ * the numbers from PROCESS_EVENT_MAX to 255 in order.
+ *
+ * \return The allocated event number, or PROCESS_EVENT_NONE if all
+ * of them have been handed out.
+ */
+process_event_t
+process_alloc_event(void)
+{
+  if(lastevent == 0) {
+    /* lastevent has wrapped: there are no numbers left. */
+    return PROCESS_EVENT_NONE;
+  }
+  return lastevent++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+call_process(struct process *p, process_event_t ev, process_data_t data);
+/*---------------------------------------------------------------------------*/
+static void
+exit_process(struct process *p, struct process *fromprocess)
+{
+  register struct process *q;
+  struct process *old_current = process_current;
+
+  /* Make sure the process is in the process list before we try to
+     exit it. */
+  for(q = process_list; q != p && q != NULL; q = q->next);
+  if(q == NULL) {
+    return;
+  }
+
+  if(p->state != PROCESS_STATE_NONE) {
+    p->state = PROCESS_STATE_NONE;
+
+    /* Tell all other processes that this process has exited, so that
+       they can free any resources allocated by it. */
+    for(q = process_list; q != NULL; q = q->next) {
+      if(p != q) {
+	call_process(q, PROCESS_EVENT_EXITED, (process_data_t)p);
+      }
+    }
+
+    /* If the process is exited by some other process, its exit
+       handler has not run yet. */
+    if(p != fromprocess && p->thread != NULL) {
+      process_current = p;
+      p->thread(&p->pt, PROCESS_EVENT_EXIT, NULL);
+    }
+  }
+
+  if(p == process_list) {
+    process_list = process_list->next;
+  } else {
+    for(q = process_list; q != NULL; q = q->next) {
+      if(q->next == p) {
+	q->next = p->next;
+	break;
+      }
+    }
+  }
+
+  process_current = old_current;
+}
+/*---------------------------------------------------------------------------*/
+static void
+call_process(struct process *p, process_event_t ev, process_data_t data)
+{
+  int ret;
+
+  if((p->state & PROCESS_STATE_RUNNING) && p->thread != NULL) {
+    process_current = p;
+    p->state = PROCESS_STATE_CALLED;
+    ret = p->thread(&p->pt, ev, data);
+    if(ret == PT_EXITED || ret == PT_ENDED || ev == PROCESS_EVENT_EXIT) {
+      exit_process(p, p);
+    } else {
+      p->state = PROCESS_STATE_RUNNING;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Start a process.
+ *
+ * The process is put on the list of running processes and its thread
+ * is called synchronously with the PROCESS_EVENT_INIT event. Starting
+ * a process that is already running has no effect.
+ *
+ * \param p A pointer to the process structure.
+ * \param arg An argument that is passed as the data of the
+ * PROCESS_EVENT_INIT event.
+ */
+void
+process_start(struct process *p, const char *arg)
+{
+  register struct process *q;
+
+  for(q = process_list; q != p && q != NULL; q = q->next);
+  if(q == p) {
+    return;
+  }
+
+  p->next = process_list;
+  process_list = p;
+  p->state = PROCESS_STATE_RUNNING;
+  p->needspoll = 0;
+  PT_INIT(&p->pt);
+
+  process_post_synch(p, PROCESS_EVENT_INIT, (process_data_t)arg);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Exit a process.
+ *
+ * The process is removed from the list of running processes and its
+ * exit handler is run. All other processes are sent a
+ * PROCESS_EVENT_EXITED event.
+ *
+ * \param p The process to exit.
+ */
+void
+process_exit(struct process *p)
+{
+  exit_process(p, PROCESS_CURRENT());
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Initialize the process scheduler.
+ *
+ * Must be called before any other function in the module.
+ */
+void
+process_init(void)
+{
+  lastevent = PROCESS_EVENT_MAX;
+
+  nevents = fevent = 0;
+  process_current = process_list = NULL;
+  poll_requested = 0;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Call the poll handler of all processes that have been polled.
+ */
+static void
+do_poll(void)
+{
+  struct process *p;
+
+  poll_requested = 0;
+  for(p = process_list; p != NULL; p = p->next) {
+    if(p->needspoll) {
+      p->state = PROCESS_STATE_RUNNING;
+      p->needspoll = 0;
+      call_process(p, PROCESS_EVENT_POLL, NULL);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Deliver the oldest event in the queue, either to its receiver or,
+ * for broadcast events, to every running process.
+ */
+static void
+do_event(void)
+{
+  process_event_t ev;
+  process_data_t data;
+  struct process *receiver;
+  struct process *p;
+
+  if(nevents > 0) {
+    ev = events[fevent].ev;
+    data = events[fevent].data;
+    receiver = events[fevent].p;
+
+    fevent = (fevent + 1) & (PROCESS_NUMEVENTS - 1);
+    --nevents;
+
+    if(receiver == PROCESS_BROADCAST) {
+      for(p = process_list; p != NULL; p = p->next) {
+	/* Service polls between the receivers so that a long
+	   broadcast does not delay them. */
+	if(poll_requested) {
+	  do_poll();
+	}
+	call_process(p, ev, data);
+      }
+    } else {
+      /* An INIT event that was posted before the process was started
+	 marks it as running. */
+      if(ev == PROCESS_EVENT_INIT) {
+	receiver->state = PROCESS_STATE_RUNNING;
+      }
+      call_process(receiver, ev, data);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Run the process scheduler once.
+ *
+ * This function should be called repeatedly from the main loop of the
+ * system. It calls the poll handlers of all polled processes and then
+ * delivers at most one event from the event queue.
+ *
+ * \return The number of events still waiting to be processed, plus
+ * one if a process has been polled. The caller may sleep when this is
+ * zero.
+ */
+int
+process_run(void)
+{
+  if(poll_requested) {
+    do_poll();
+  }
+
+  do_event();
+
+  return nevents + poll_requested;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Get the number of events waiting to be processed.
+ */
+process_num_events_t
+process_nevents(void)
+{
+  return nevents + poll_requested;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Post an asynchronous event.
+ *
+ * The event is put on the event queue and is delivered by a later
+ * call to process_run(). This function must not be called from an
+ * interrupt handler; use process_poll() instead.
+ *
+ * \param p The receiving process, or PROCESS_BROADCAST.
+ * \param ev The event.
+ * \param data Auxiliary data passed with the event.
+ *
+ * \retval PROCESS_ERR_OK The event was posted.
+ * \retval PROCESS_ERR_FULL The event queue was full.
+ */
+int
+process_post(struct process *p, process_event_t ev, process_data_t data)
+{
+  process_num_events_t snum;
+
+  if(nevents == PROCESS_NUMEVENTS) {
+    return PROCESS_ERR_FULL;
+  }
+
+  snum = (fevent + nevents) & (PROCESS_NUMEVENTS - 1);
+  events[snum].ev = ev;
+  events[snum].data = data;
+  events[snum].p = p;
+  ++nevents;
+
+  return PROCESS_ERR_OK;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Post a synchronous event.
+ *
+ * The receiving process is called directly, and this function returns
+ * when it has processed the event.
+ *
+ * \param p The receiving process.
+ * \param ev The event.
+ * \param data Auxiliary data passed with the event.
+ */
+void
+process_post_synch(struct process *p, process_event_t ev, process_data_t data)
+{
+  struct process *caller = process_current;
+
+  call_process(p, ev, data);
+  process_current = caller;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Request that a process is polled.
+ *
+ * The poll handler of the process is called from the next invocation
+ * of process_run(). Polling does not use the event queue and it is
+ * safe to call this function from an interrupt handler.
+ *
+ * \param p The process to poll.
+ */
+void
+process_poll(struct process *p)
+{
+  if(p != NULL &&
+     (p->state == PROCESS_STATE_RUNNING ||
+      p->state == PROCESS_STATE_CALLED)) {
+    p->needspoll = 1;
+    poll_requested = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Check if a process is running.
+ *
+ * \param p The process.
+ *
+ * \return Non-zero if the process is running.
+ */
+int
+process_is_running(struct process *p)
+{
+  return p->state != PROCESS_STATE_NONE;
+}
+/*---------------------------------------------------------------------------*/
+
+/** @} */
@@ -111,44 +111,74 @@ static u8_t
 buf_bufto(register struct psock_buf *buf, u8_t endmarker,
 	  register u8_t **dataptr, register u16_t *datalen)
 {
-  u8_t c;
-  while(buf->left > 0 && *datalen > 0) {
-    c = *buf->ptr = **dataptr;
-    ++*dataptr;
-    ++buf->ptr;
-    --*datalen;
-    --buf->left;
-    
-    if(c == endmarker) {
-      return BUF_FOUND;
-    }
+  u8_t *end;
+  u16_t len, copylen;
+
+  /* Find the end marker first, and then copy everything up to and
+     including it at once. */
+  end = memchr(*dataptr, endmarker, *datalen);
+  if(end != NULL) {
+    len = end - *dataptr + 1;
+  } else {
+    len = *datalen;
   }
 
-  if(*datalen == 0) {
-    return BUF_NOT_FOUND;
+  /* What does not fit in the buffer is skipped. */
+  copylen = len < buf->left? len: buf->left;
+  memcpy(buf->ptr, *dataptr, copylen);
+  buf->ptr += copylen;
+  buf->left -= copylen;
+  *dataptr += len;
+  *datalen -= len;
+
+  if(copylen < len) {
+    return end != NULL? BUF_FOUND | BUF_FULL: BUF_FULL;
   }
+  return end != NULL? BUF_FOUND: BUF_NOT_FOUND;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Copy len bytes, starting off bytes into the pieces of a
+ * psock_sendv(), to the uip_appdata buffer.
+ */
+static void
+iov_gather(const struct psock_iov *iov, u16_t off, u16_t len)
+{
+  u8_t *dst;
+  u16_t n;
 
-  while(*datalen > 0) {
-    c = **dataptr;
-    --*datalen;
-    ++*dataptr;
-    
-    if(c == endmarker) {
-      return BUF_FOUND | BUF_FULL;
+  dst = uip_appdata;
+  while(len > 0) {
+    n = iov->len - off;
+    if(n > len) {
+      n = len;
     }
+    memcpy(dst, iov->ptr + off, n);
+    dst += n;
+    len -= n;
+    off = 0;
+    ++iov;
   }
-  
-  return BUF_FULL;
 }
 /*---------------------------------------------------------------------------*/
 static char
 send_data(register struct psock *s)
 {
+  u16_t len;
+
   if(s->state != STATE_DATA_SENT || uip_rexmit()) {
     if(s->sendlen > uip_mss()) {
-      uip_send(s->sendptr, uip_mss());
+      len = uip_mss();
     } else {
-      uip_send(s->sendptr, s->sendlen);
+      len = s->sendlen;
+    }
+    if(s->sendiov != NULL) {
+      /* The segment is gathered from the pieces again for every
+	 retransmission. */
+      iov_gather(s->sendiov, s->sendoff, len);
+      uip_send(uip_appdata, len);
+    } else {
+      uip_send(s->sendptr, len);
     }
     s->state = STATE_DATA_SENT;
     return 1;
@@ -159,13 +189,24 @@ send_data(register struct psock *s)
 static char
 data_acked(register struct psock *s)
 {
+  u16_t len;
+
   if(s->state == STATE_DATA_SENT && uip_acked()) {
     if(s->sendlen > uip_mss()) {
-      s->sendlen -= uip_mss();
-      s->sendptr += uip_mss();
+      len = uip_mss();
     } else {
-      s->sendptr += s->sendlen;
-      s->sendlen = 0;
+      len = s->sendlen;
+    }
+    s->sendlen -= len;
+    if(s->sendiov != NULL) {
+      /* Move on to the piece that holds the next unsent byte. */
+      s->sendoff += len;
+      while(s->sendlen > 0 && s->sendoff >= s->sendiov->len) {
+	s->sendoff -= s->sendiov->len;
+	++s->sendiov;
+      }
+    } else {
+      s->sendptr += len;
     }
     s->state = STATE_ACKED;
     return 1;
@@ -173,6 +214,46 @@ data_acked(register struct psock *s)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+static char
+data_is_sent_and_acked(register struct psock *s)
+{
+  /* If the segment we sent has been acknowledged, we move past it and
+     return 1. The caller then calls us again right away if there is
+     more data, and the next segment is sent. Otherwise we send the
+     segment, or retransmit it, and return 0. */
+  if(data_acked(s)) {
+    return 1;
+  }
+  send_data(s);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Send the s->sendlen bytes at s->sendptr, and wait until all of them
+ * have been acknowledged. Used inside the protothread of the psock
+ * functions.
+ */
+#define SEND_WAIT(s)						\
+  do {								\
+    (s)->state = STATE_NONE;					\
+    while((s)->sendlen > 0) {					\
+      PT_WAIT_UNTIL(&(s)->psockpt, data_is_sent_and_acked(s));	\
+    }								\
+    (s)->state = STATE_NONE;					\
+  } while(0)
+
+/*
+ * Send the data in the output buffer, as one segment if it fits in
+ * one, and wait until it has been acknowledged.
+ */
+#define FLUSH_WAIT(s)						\
+  do {								\
+    (s)->sendptr = (u8_t *)(s)->outbufptr;			\
+    (s)->sendlen = (s)->outlen;					\
+    SEND_WAIT(s);						\
+    (s)->outlen = 0;						\
+  } while(0)
+/*---------------------------------------------------------------------------*/
 PT_THREAD(psock_send(register struct psock *s, const char *buf,
 		     unsigned int len))
 {
@@ -183,6 +264,11 @@ PT_THREAD(psock_send(register struct psock *s, const char *buf,
     PT_EXIT(&s->psockpt);
   }
 
+  /* Data written with psock_write() goes out first. */
+  if(s->outlen > 0) {
+    FLUSH_WAIT(s);
+  }
+
   /* Save the length of and a pointer to the data that is to be
      sent. */
   s->sendptr = buf;
@@ -191,20 +277,18 @@ PT_THREAD(psock_send(register struct psock *s, const char *buf,
   s->state = STATE_NONE;
 
   /* We loop here until all data is sent. The s->sendlen variable is
-     updated by the data_sent() function. */
+     updated by the data_acked() function. */
   while(s->sendlen > 0) {
 
     /*
-     * The condition for this PT_WAIT_UNTIL is a little tricky: the
-     * protothread will wait here until all data has been acknowledged
-     * (data_acked() returns true) and until all data has been sent
-     * (send_data() returns true). The two functions data_acked() and
-     * send_data() must be called in succession to ensure that all
-     * data is sent. Therefore the & operator is used instead of the
-     * && operator, which would cause only the data_acked() function
-     * to be called when it returns false.
+     * The protothread waits here until the segment that was sent has
+     * been acknowledged. Each time around the loop, the next segment
+     * is sent before we wait again. Sending and acknowledging must
+     * not be checked in the same condition, since the condition is
+     * evaluated again in the same call when we loop, and would then
+     * take the ACK of the previous segment for an ACK of the next.
      */
-    PT_WAIT_UNTIL(&s->psockpt, data_acked(s) & send_data(s));
+    PT_WAIT_UNTIL(&s->psockpt, data_is_sent_and_acked(s));
   }
 
   s->state = STATE_NONE;
@@ -212,6 +296,79 @@ PT_THREAD(psock_send(register struct psock *s, const char *buf,
   PT_END(&s->psockpt);
 }
 /*---------------------------------------------------------------------------*/
+PT_THREAD(psock_sendv(register struct psock *s, const struct psock_iov *iov,
+		      unsigned int iovcnt))
+{
+  unsigned int i;
+
+  PT_BEGIN(&s->psockpt);
+
+  /* Data written with psock_write() goes out first. */
+  if(s->outlen > 0) {
+    FLUSH_WAIT(s);
+  }
+
+  s->sendlen = 0;
+  for(i = 0; i < iovcnt; ++i) {
+    s->sendlen += iov[i].len;
+  }
+
+  /* Skip empty pieces at the start, so that s->sendiov always points
+     to the piece that holds the next byte to send. */
+  while(s->sendlen > 0 && iov->len == 0) {
+    ++iov;
+  }
+  s->sendiov = iov;
+  s->sendoff = 0;
+
+  SEND_WAIT(s);
+
+  s->sendiov = NULL;
+
+  PT_END(&s->psockpt);
+}
+/*---------------------------------------------------------------------------*/
+PT_THREAD(psock_write(register struct psock *s, const char *buf,
+		      unsigned int len))
+{
+  PT_BEGIN(&s->psockpt);
+
+  /* If there is no data to write, we exit immediately. */
+  if(len == 0) {
+    PT_EXIT(&s->psockpt);
+  }
+
+  /* If the data does not fit after what is already buffered, we
+     first send out the buffer. */
+  if(s->outlen + len > s->outbufsize && s->outlen > 0) {
+    FLUSH_WAIT(s);
+  }
+
+  if(len > s->outbufsize) {
+    /* Data that does not fit in the buffer at all is sent directly,
+       as with psock_send(). */
+    s->sendptr = buf;
+    s->sendlen = len;
+    SEND_WAIT(s);
+  } else {
+    memcpy(s->outbufptr + s->outlen, buf, len);
+    s->outlen += len;
+  }
+
+  PT_END(&s->psockpt);
+}
+/*---------------------------------------------------------------------------*/
+PT_THREAD(psock_flush(register struct psock *s))
+{
+  PT_BEGIN(&s->psockpt);
+
+  if(s->outlen > 0) {
+    FLUSH_WAIT(s);
+  }
+
+  PT_END(&s->psockpt);
+}
+/*---------------------------------------------------------------------------*/
 PT_THREAD(psock_generator_send(register struct psock *s,
 			       unsigned short (*generate)(void *), void *arg))
 {
@@ -222,6 +379,11 @@ PT_THREAD(psock_generator_send(register struct psock *s,
     PT_EXIT(&s->psockpt);
   }
 
+  /* Data written with psock_write() goes out first. */
+  if(s->outlen > 0) {
+    FLUSH_WAIT(s);
+  }
+
   /* Call the generator function to generate the data in the
      uip_appdata buffer. */
   s->sendlen = generate(arg);
@@ -235,7 +397,7 @@ PT_THREAD(psock_generator_send(register struct psock *s,
       generate(arg);
     }
     /* Wait until all data is sent and acknowledged. */
-    PT_WAIT_UNTIL(&s->psockpt, data_acked(s) & send_data(s));
+    PT_WAIT_UNTIL(&s->psockpt, data_is_sent_and_acked(s));
   } while(s->sendlen > 0);
   
   s->state = STATE_NONE;
@@ -273,6 +435,12 @@ PT_THREAD(psock_readto(register struct psock *psock, unsigned char c))
 {
   PT_BEGIN(&psock->psockpt);
 
+  /* Data written with psock_write() is sent before we wait for the
+     peer. */
+  if(psock->outlen > 0) {
+    FLUSH_WAIT(psock);
+  }
+
   buf_setup(&psock->buf, psock->bufptr, psock->bufsize);
   
   /* XXX: Should add buf_checkmarker() before do{} loop, if
@@ -300,6 +468,12 @@ PT_THREAD(psock_readbuf(register struct psock *psock))
 {
   PT_BEGIN(&psock->psockpt);
 
+  /* Data written with psock_write() is sent before we wait for the
+     peer. */
+  if(psock->outlen > 0) {
+    FLUSH_WAIT(psock);
+  }
+
   buf_setup(&psock->buf, psock->bufptr, psock->bufsize);
   
   /* XXX: Should add buf_checkmarker() before do{} loop, if
@@ -324,6 +498,38 @@ PT_THREAD(psock_readbuf(register struct psock *psock))
   PT_END(&psock->psockpt);
 }
 /*---------------------------------------------------------------------------*/
+PT_THREAD(psock_peek(register struct psock *psock))
+{
+  PT_BEGIN(&psock->psockpt);
+
+  /* Data written with psock_write() is sent before we wait for the
+     peer. */
+  if(psock->outlen > 0) {
+    FLUSH_WAIT(psock);
+  }
+
+  /* Only wait if everything in the current segment has been
+     consumed. The data is left where it is in uip_appdata. */
+  if(psock->readlen == 0) {
+    PT_WAIT_UNTIL(&psock->psockpt, psock_newdata(psock));
+    psock->state = STATE_READ;
+    psock->readptr = (u8_t *)uip_appdata;
+    psock->readlen = uip_datalen();
+  }
+
+  PT_END(&psock->psockpt);
+}
+/*---------------------------------------------------------------------------*/
+void
+psock_consume(register struct psock *psock, u16_t len)
+{
+  if(len > psock->readlen) {
+    len = psock->readlen;
+  }
+  psock->readptr += len;
+  psock->readlen -= len;
+}
+/*---------------------------------------------------------------------------*/
 void
 psock_init(register struct psock *psock, char *buffer, unsigned int buffersize)
 {
@@ -332,7 +538,19 @@ psock_init(register struct psock *psock, char *buffer, unsigned int buffersize)
   psock->bufptr = buffer;
   psock->bufsize = buffersize;
   buf_setup(&psock->buf, buffer, buffersize);
+  psock->sendiov = NULL;
+  psock->outbufptr = NULL;
+  psock->outbufsize = 0;
+  psock->outlen = 0;
   PT_INIT(&psock->pt);
   PT_INIT(&psock->psockpt);
 }
 /*---------------------------------------------------------------------------*/
+void
+psock_outbuf(register struct psock *psock, char *buffer, u16_t buffersize)
+{
+  psock->outbufptr = buffer;
+  psock->outbufsize = buffersize;
+  psock->outlen = 0;
+}
+/*---------------------------------------------------------------------------*/
@@ -35,26 +35,61 @@
 
 #include <string.h>
 
-#include "uip-split.h"
 #include "uip.h"
+#include "uip-split.h"
 #include "uip-fw.h"
 #include "uip_arch.h"
 
 
 
+#if UIP_SPLIT
+
 #define BUF ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
 
+#define TCP_FIN 0x01
+#define TCP_SYN 0x02
+#define TCP_RST 0x04
+
+/* The length of the TCP header, including the options. */
+#define TCP_HLEN ((BUF->tcpoffset >> 4) << 2)
+
+/*-----------------------------------------------------------------------------*/
+/* Check if the packet in uip_buf is a TCP segment that should be
+   split. Segments with any of SYN, FIN or RST set are sent as they
+   are. The options of other segments, such as timestamps, are copied
+   to both halves. */
+static int
+split_wanted(void)
+{
+  if(BUF->proto != UIP_PROTO_TCP ||
+     TCP_HLEN < UIP_TCPH_LEN ||
+     (BUF->flags & (TCP_FIN | TCP_SYN | TCP_RST)) != 0 ||
+     uip_len < UIP_IPH_LEN + TCP_HLEN + 2) {
+    return 0;
+  }
+#if UIP_SPLIT == UIP_SPLIT_ADAPTIVE
+  /* The segment belongs to the connection that uIP last processed,
+     unless it is a reply to a segment for a closed port. */
+  return uip_conn != NULL && uip_conn->delack &&
+    BUF->srcport == uip_conn->lport &&
+    BUF->destport == uip_conn->rport &&
+    uip_ipaddr_cmp(BUF->destipaddr, uip_conn->ripaddr);
+#else /* UIP_SPLIT == UIP_SPLIT_ADAPTIVE */
+  return 1;
+#endif /* UIP_SPLIT == UIP_SPLIT_ADAPTIVE */
+}
 /*-----------------------------------------------------------------------------*/
 void
 uip_split_output(void)
 {
-  u16_t tcplen, len1, len2;
+  u16_t tcplen, len1, len2, sum2, chksum;
+  u8_t hlen;
 
-  /* We only try to split maximum sized TCP segments. */
-  if(BUF->proto == UIP_PROTO_TCP &&
-     uip_len == UIP_BUFSIZE - UIP_LLH_LEN) {
+  if(split_wanted()) {
+    hlen = TCP_HLEN;
+    uip_appdata = &uip_buf[UIP_LLH_LEN + UIP_IPH_LEN + hlen];
 
-    tcplen = uip_len - UIP_TCPIP_HLEN;
+    tcplen = uip_len - UIP_IPH_LEN - hlen;
     /* Split the segment in two. If the original packet length was
        odd, we make the second packet one byte larger. */
     len1 = len2 = tcplen / 2;
@@ -62,9 +97,14 @@ uip_split_output(void)
       ++len2;
     }
 
+    /* Sum the data of the second packet once. The sum is used both
+       to remove the data from the checksum of the first packet and to
+       compute the checksum of the second packet. */
+    sum2 = uip_chksum((u16_t *)((u8_t *)uip_appdata + len1), len2);
+
     /* Create the first packet. This is done by altering the length
        field of the IP header and updating the checksums. */
-    uip_len = len1 + UIP_TCPIP_HLEN;
+    uip_len = len1 + UIP_IPH_LEN + hlen;
 #if UIP_CONF_IPV6
     /* For IPv6, the IP length field does not include the IPv6 IP header
        length. */
@@ -75,26 +115,37 @@ uip_split_output(void)
     BUF->len[1] = uip_len & 0xff;
 #endif /* UIP_CONF_IPV6 */
     
-    /* Recalculate the TCP checksum. */
-    BUF->tcpchksum = 0;
-    BUF->tcpchksum = ~(uip_tcpchksum());
+    /* Update the TCP checksum for the removed data and the new length
+       in the pseudo header (see RFC1624). If the second packet starts
+       at an odd offset, its data was summed with the bytes swapped
+       with respect to the first packet. */
+    if(len1 & 1) {
+      sum2 = (sum2 << 8) | (sum2 >> 8);
+    }
+    BUF->tcpchksum = uip_chksum_adjust(BUF->tcpchksum, sum2, 0);
+    BUF->tcpchksum = uip_chksum_adjust(BUF->tcpchksum,
+				       HTONS(tcplen + hlen),
+				       HTONS(len1 + hlen));
+    if(len1 & 1) {
+      sum2 = (sum2 << 8) | (sum2 >> 8);
+    }
 
 #if !UIP_CONF_IPV6
-    /* Recalculate the IP checksum. */
-    BUF->ipchksum = 0;
-    BUF->ipchksum = ~(uip_ipchksum());
+    /* Update the IP checksum for the new length. */
+    BUF->ipchksum = uip_chksum_adjust(BUF->ipchksum,
+				      HTONS(tcplen + UIP_IPH_LEN + hlen),
+				      HTONS(uip_len));
 #endif /* UIP_CONF_IPV6 */
     
     /* Transmit the first packet. */
-    /*    uip_fw_output();*/
-    tcpip_output();
+    UIP_SPLIT_OUTPUT();
 
     /* Now, create the second packet. To do this, it is not enough to
        just alter the length field, but we must also update the TCP
        sequence number and point the uip_appdata to a new place in
        memory. This place is detemined by the length of the first
        packet (len1). */
-    uip_len = len2 + UIP_TCPIP_HLEN;
+    uip_len = len2 + UIP_IPH_LEN + hlen;
 #if UIP_CONF_IPV6
     /* For IPv6, the IP length field does not include the IPv6 IP header
        length. */
@@ -114,23 +165,31 @@ uip_split_output(void)
     BUF->seqno[2] = uip_acc32[2];
     BUF->seqno[3] = uip_acc32[3];
     
-    /* Recalculate the TCP checksum. */
+    /* The TCP checksum of the second packet is the sum of the pseudo
+       header, the TCP header with its options and the data that was
+       summed above. The IP addresses of the pseudo header are directly
+       followed by the TCP header. */
     BUF->tcpchksum = 0;
-    BUF->tcpchksum = ~(uip_tcpchksum());
+    chksum = uip_chksum_adjust(0xffff, 0,
+			       uip_chksum((u16_t *)&BUF->srcipaddr[0],
+					  2 * sizeof(uip_ipaddr_t) + hlen));
+    chksum = uip_chksum_adjust(chksum, 0,
+			       HTONS(len2 + hlen + UIP_PROTO_TCP));
+    BUF->tcpchksum = uip_chksum_adjust(chksum, 0, sum2);
 
 #if !UIP_CONF_IPV6
-    /* Recalculate the IP checksum. */
-    BUF->ipchksum = 0;
-    BUF->ipchksum = ~(uip_ipchksum());
+    /* Update the IP checksum for the new length. */
+    BUF->ipchksum = uip_chksum_adjust(BUF->ipchksum,
+				      HTONS(len1 + UIP_IPH_LEN + hlen),
+				      HTONS(uip_len));
 #endif /* UIP_CONF_IPV6 */
 
     /* Transmit the second packet. */
-    /*    uip_fw_output();*/
-    tcpip_output();
+    UIP_SPLIT_OUTPUT();
   } else {
-    /*    uip_fw_output();*/
-    tcpip_output();
+    UIP_SPLIT_OUTPUT();
   }
      
 }
 /*-----------------------------------------------------------------------------*/
+#endif /* UIP_SPLIT */
@@ -87,6 +87,16 @@
 #include "uip-neighbor.h"
 #endif /* UIP_CONF_IPV6 */
 
+#if UIP_SPLIT == UIP_SPLIT_ADAPTIVE || UIP_TCP_FINE_RTO || \
+    UIP_TCP_TIMESTAMPS || UIP_TCP_SYNCOOKIES
+#include "clock.h"
+#endif /* UIP_SPLIT == UIP_SPLIT_ADAPTIVE || UIP_TCP_FINE_RTO ||
+	  UIP_TCP_TIMESTAMPS || UIP_TCP_SYNCOOKIES */
+
+#if UIP_TCP_APPSTATE_POOL
+#include "memb.h"
+#endif /* UIP_TCP_APPSTATE_POOL */
+
 #include <string.h>
 
 /*---------------------------------------------------------------------------*/
@@ -157,6 +167,12 @@ u16_t uip_len, uip_slen;
 				depending on the maximum packet
 				size. */
 
+#if UIP_RX_CHKSUM
+u16_t uip_rxsum;             /* The sum of the IP payload, computed by
+				the device driver. */
+u8_t uip_rxsum_valid;
+#endif /* UIP_RX_CHKSUM */
+
 u8_t uip_flags;     /* The uip_flags variable is used for
 				communication between the TCP/IP stack
 				and the application program. */
@@ -169,6 +185,117 @@ struct uip_conn uip_conns[UIP_CONNS];
 u16_t uip_listenports[UIP_LISTENPORTS];
                              /* The uip_listenports list all currently
 				listning ports. */
+volatile u8_t uip_pollreqs;  /* Set by uip_request_poll() when any
+				connection wants to be polled. */
+#if UIP_TCP_SYNCOOKIES
+u32_t uip_syncookie_secret;  /* The key of the SYN cookies. */
+#endif /* UIP_TCP_SYNCOOKIES */
+#if UIP_ACTIVE_OPEN
+u32_t uip_portkey;           /* The key of the local port choice. */
+#endif /* UIP_ACTIVE_OPEN */
+
+#if (UIP_TCP_HASH_SIZE & (UIP_TCP_HASH_SIZE - 1)) != 0 || \
+    (UIP_LISTEN_HASH_SIZE & (UIP_LISTEN_HASH_SIZE - 1)) != 0
+#error UIP_TCP_HASH_SIZE and UIP_LISTEN_HASH_SIZE must be powers of two
+#endif
+#if UIP_LISTENPORTS > 255
+#error UIP_LISTENPORTS must be at most 255
+#endif
+
+static struct uip_conn *tcp_hashtab[UIP_TCP_HASH_SIZE];
+                             /* All connections that are not CLOSED,
+				chained through ->hnext and hashed on
+				remote IP address and port pair. */
+static struct uip_conn *tcp_freelist;
+                             /* All CLOSED connections, chained
+				through ->hnext. */
+static u8_t tcp_nfree;       /* The number of connections in
+				tcp_freelist. */
+static u8_t listen_hashtab[UIP_LISTEN_HASH_SIZE];
+static u8_t listen_next[UIP_LISTENPORTS];
+                             /* The listening ports, hashed on the port
+				number. The entries are indices into
+				uip_listenports plus one, zero ends a
+				chain. */
+
+#if UIP_TCP_SNDQ
+/* A segment in a TCP send queue. The sequence number of a segment is
+   not stored; the queue holds the data from snd_nxt onwards without
+   gaps. */
+struct uip_sndseg {
+  struct uip_sndseg *next;
+  u16_t len;
+  u8_t data[UIP_TCP_MSS];
+};
+static struct uip_sndseg sndsegs[UIP_TCP_SNDQ_SEGS];
+static struct uip_sndseg *sndseg_free;
+static u16_t sndoff;         /* Offset from snd_nxt of the segment
+				being sent. */
+static struct uip_sndseg *sndseg;
+                             /* The segment being sent. */
+
+/* Values for uip_conn->sndflags. */
+#define SND_ACCEPTED  0x01   /* Data was queued and the application
+				has not yet been told. */
+#define SND_REFUSED   0x02   /* Data was refused since the queue was
+				full. */
+#define SND_CLOSEPEND 0x04   /* The application has closed the
+				connection, the FIN is sent when the
+				queue has drained. */
+#define SND_RECOVERY  0x08   /* In fast recovery after a fast
+				retransmit. */
+#define SND_REXMIT    0x10   /* The oldest segment should be sent
+				again. */
+
+/* The initial congestion window, in segments (RFC 3390). */
+#define TCP_INITIAL_CWND 4
+
+#define SNDQ_EMPTY(conn) ((conn)->sndq == NULL)
+#else /* UIP_TCP_SNDQ */
+#define SNDQ_EMPTY(conn) 1
+#endif /* UIP_TCP_SNDQ */
+
+#if UIP_TCP_OOQ
+/* A segment that was received ahead of rcv_nxt. */
+struct uip_ooseg {
+  struct uip_ooseg *next;
+  u32_t seq;
+  u16_t len;
+  u8_t data[UIP_TCP_MSS];
+};
+static struct uip_ooseg oosegs[UIP_TCP_OOQ_SEGS];
+static struct uip_ooseg *ooseg_free;
+#endif /* UIP_TCP_OOQ */
+
+#if UIP_TCP_TW_CONNS
+/* A connection in FIN_WAIT_2 or TIME_WAIT, kept outside uip_conns. */
+struct uip_twconn {
+  uip_ipaddr_t ripaddr;
+  u16_t lport, rport;
+  u32_t snd_nxt, rcv_nxt;
+#if UIP_TCP_TIMESTAMPS
+  u32_t ts_recent;
+  u8_t tcpopts;
+#endif /* UIP_TCP_TIMESTAMPS */
+  u8_t state;                /* UIP_FIN_WAIT_2, UIP_TIME_WAIT or
+				UIP_CLOSED if the entry is unused. */
+  u8_t timer;                /* Timer pulses since the state was
+				entered. */
+};
+static struct uip_twconn tcp_twconns[UIP_TCP_TW_CONNS];
+static struct uip_twconn *twconn;
+#endif /* UIP_TCP_TW_CONNS */
+
+/* Non-zero if sequence number a comes before b. */
+#define SEQ_LT(a, b) ((u32_t)((a) - (b)) & 0x80000000UL)
+
+#if UIP_TCP_SEQ32
+#define RCV_NXT(conn) ((conn)->rcv_nxt)
+#define SND_NXT(conn) ((conn)->snd_nxt)
+#else /* UIP_TCP_SEQ32 */
+#define RCV_NXT(conn) seq_get((conn)->rcv_nxt)
+#define SND_NXT(conn) seq_get((conn)->snd_nxt)
+#endif /* UIP_TCP_SEQ32 */
 #if UIP_UDP
 struct uip_udp_conn *uip_udp_conn;
 struct uip_udp_conn uip_udp_conns[UIP_UDP_CONNS];
@@ -180,18 +307,75 @@ static u16_t ipid;           /* Ths ipid variable is an increasing
 
 void uip_setipid(u16_t id) { ipid = id; }
 
+#if UIP_TCP_SEQ32
+static u32_t iss;            /* The iss variable is used for the TCP
+				initial sequence number. */
+#else /* UIP_TCP_SEQ32 */
 static u8_t iss[4];          /* The iss variable is used for the TCP
 				initial sequence number. */
+#endif /* UIP_TCP_SEQ32 */
 
 #if UIP_ACTIVE_OPEN
 static u16_t lastport;       /* Keeps track of the last port used for
-				a new connection. */
+				a new UDP connection. */
+static u16_t tcp_portnext;   /* Advanced for every local port tried
+				by uip_connect(). */
 #endif /* UIP_ACTIVE_OPEN */
 
+#if UIP_TCP_HDRPRED
+static struct uip_conn *tcp_lastconn;
+                             /* The connection that received the last
+				segment, used for header prediction. */
+#endif /* UIP_TCP_HDRPRED */
+
+#if UIP_TCP_FINE_RTO
+static u32_t rexmit_next;    /* The earliest retransmission timer that
+				uip_rexmit_due() waits for, valid if
+				rexmit_armed is set. */
+static u8_t rexmit_armed;
+
+/* Non-zero if the clock has reached the time t. */
+#define CLOCK_REACHED(t) ((u32_t)((u32_t)clock_time() - (t)) < 0x80000000UL)
+
+#define TCP_TIMER_SET(conn, t) tcp_timer_set(conn, t)
+#define TCP_TIMER_EXPIRED(conn) CLOCK_REACHED((conn)->rtx_time)
+#else /* UIP_TCP_FINE_RTO */
+#define TCP_TIMER_SET(conn, t) ((conn)->timer = (t))
+#define TCP_TIMER_EXPIRED(conn) ((conn)->timer-- == 0)
+#endif /* UIP_TCP_FINE_RTO */
+
+/* A connection is idle from the last segment received from the
+   peer. */
+#if UIP_TCP_KEEPALIVE
+#define TCP_IDLE_RESET(conn) ((conn)->idle = 0, (conn)->kaprobes = 0)
+#elif UIP_TCP_EVICT_IDLE
+#define TCP_IDLE_RESET(conn) ((conn)->idle = 0)
+#else /* UIP_TCP_KEEPALIVE */
+#define TCP_IDLE_RESET(conn)
+#endif /* UIP_TCP_KEEPALIVE */
+
+/* Non-zero if an acknowledgement of new data gives an RTT sample:
+   not after a retransmission, since it may be for either copy of the
+   segment (Karn), unless the timestamps tell which. */
+#if UIP_TCP_FINE_RTO && UIP_TCP_TIMESTAMPS
+#define TCP_RTT_OK(conn) ((conn)->nrtx == 0 || ts_ecr != 0)
+#else /* UIP_TCP_FINE_RTO && UIP_TCP_TIMESTAMPS */
+#define TCP_RTT_OK(conn) ((conn)->nrtx == 0)
+#endif /* UIP_TCP_FINE_RTO && UIP_TCP_TIMESTAMPS */
+
+#if UIP_TCP_TIMESTAMPS
+static u32_t ts_val, ts_ecr; /* The timestamps of the segment that is
+				being processed. ts_ecr is zero if it
+				had none. */
+#endif /* UIP_TCP_TIMESTAMPS */
+
 /* Temporary variables. */
 u8_t uip_acc32[4];
-static u8_t c, opt;
+static u8_t c;
 static u16_t tmp16;
+#if UIP_TCP_SNDQ || UIP_TCP_SEQ32 || UIP_TCP_OOQ || UIP_TCP_FINE_RTO
+static u32_t tmp32;
+#endif /* UIP_TCP_SNDQ || UIP_TCP_SEQ32 || UIP_TCP_OOQ || UIP_TCP_FINE_RTO */
 
 /* Structures and definitions. */
 #define TCP_FIN 0x01
@@ -205,8 +389,34 @@ static u16_t tmp16;
 #define TCP_OPT_END     0   /* End of TCP options list */
 #define TCP_OPT_NOOP    1   /* "No-operation" TCP option */
 #define TCP_OPT_MSS     2   /* Maximum segment size TCP option */
+#define TCP_OPT_WS      3   /* Window scale TCP option */
+#define TCP_OPT_TS      8   /* Timestamps TCP option */
 
 #define TCP_OPT_MSS_LEN 4   /* Length of TCP MSS option. */
+#define TCP_OPT_WS_LEN  3   /* Length of TCP window scale option. */
+#define TCP_OPT_TS_LEN  10  /* Length of TCP timestamps option. */
+#define TCP_OPT_TS_ALIGNED_LEN 12 /* Length of the timestamps option
+				     with the two NOPs that we send in
+				     front of it. */
+
+#define TCP_DEFAULT_MSS 536 /* The MSS of a peer that sends no MSS
+			       option. */
+
+/* The uip_conn->tcpopts bits. */
+#define TCP_OPTS_WSHIFT 0x0f /* The window scale of the peer. */
+#define TCP_OPTS_WS     0x40 /* Window scaling is used. */
+#define TCP_OPTS_TS     0x80 /* Timestamps are used. */
+
+/* The options that we offer in a SYN. */
+#define TCP_OPTS_OFFER ((UIP_TCP_WSCALE? TCP_OPTS_WS: 0) | \
+			(UIP_TCP_TIMESTAMPS? TCP_OPTS_TS: 0))
+
+#if UIP_TCP_TIMESTAMPS
+/* The length of the options that are sent in every segment of a
+   connection, in front of the data. */
+#define TCP_OPTLEN(conn) ((conn)->tcpopts & TCP_OPTS_TS? \
+			  TCP_OPT_TS_ALIGNED_LEN: 0)
+#endif /* UIP_TCP_TIMESTAMPS */
 
 #define ICMP_ECHO_REPLY 0
 #define ICMP_ECHO       8
@@ -375,17 +585,567 @@ uip_udpchksum(void)
 #endif /* UIP_UDP_CHECKSUMS */
 #endif /* UIP_ARCH_CHKSUM */
 /*---------------------------------------------------------------------------*/
+u16_t
+uip_chksum_adjust(u16_t chksum, u16_t oldval, u16_t newval)
+{
+  u32_t sum;
+
+  /* HC' = ~(~HC + ~m + m'), equation 3 of RFC1624. */
+  sum = (u16_t)~chksum + (u16_t)~oldval + newval;
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+  return ~sum;
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_CONF_IPV6
+#define IPADDR_FOLD(a) ((a)[0] ^ (a)[1] ^ (a)[2] ^ (a)[3] ^ \
+			(a)[4] ^ (a)[5] ^ (a)[6] ^ (a)[7])
+#else /* UIP_CONF_IPV6 */
+#define IPADDR_FOLD(a) ((a)[0] ^ (a)[1])
+#endif /* UIP_CONF_IPV6 */
+
+static u8_t
+tcp_hash(const u16_t *ripaddr, u16_t rport, u16_t lport)
+{
+  u16_t h;
+
+  h = IPADDR_FOLD(ripaddr) ^ rport ^ lport;
+  return (h ^ (h >> 8)) & (UIP_TCP_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+static u8_t
+listen_hash(u16_t port)
+{
+  return (port ^ (port >> 8)) & (UIP_LISTEN_HASH_SIZE - 1);
+}
+/*---------------------------------------------------------------------------*/
+/* Insert a connection into the connection hash table. Must be called
+   once the addresses and ports of the connection are set up and it
+   leaves the CLOSED state. */
+static void
+tcp_hash_add(struct uip_conn *conn)
+{
+  struct uip_conn **bucket;
+
+  bucket = &tcp_hashtab[tcp_hash(conn->ripaddr, conn->rport, conn->lport)];
+  conn->hnext = *bucket;
+  *bucket = conn;
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP_SNDQ || UIP_TCP_SEQ32 || UIP_TCP_OOQ || UIP_TCP_TIMESTAMPS || \
+    UIP_TCP_SYNCOOKIES || UIP_TCP_TW_CONNS || UIP_TCP_KEEPALIVE
+/* Read a sequence number or a timestamp from a TCP header. */
+static u32_t
+seq_get(const u8_t *seq)
+{
+  return ((u32_t)seq[0] << 24) | ((u32_t)seq[1] << 16) |
+    ((u32_t)seq[2] << 8) | seq[3];
+}
+#endif /* UIP_TCP_SNDQ || UIP_TCP_SEQ32 || UIP_TCP_OOQ || UIP_TCP_TIMESTAMPS ||
+	  UIP_TCP_SYNCOOKIES || UIP_TCP_TW_CONNS || UIP_TCP_KEEPALIVE */
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP_SEQ32 || UIP_TCP_TIMESTAMPS || UIP_TCP_SYNCOOKIES || \
+    UIP_TCP_TW_CONNS || UIP_TCP_KEEPALIVE
+/* Write a sequence number or a timestamp to a TCP header. */
+static void
+seq_put(u8_t *seq, u32_t n)
+{
+  seq[0] = n >> 24;
+  seq[1] = n >> 16;
+  seq[2] = n >> 8;
+  seq[3] = n;
+}
+#endif /* UIP_TCP_SEQ32 || UIP_TCP_TIMESTAMPS || UIP_TCP_SYNCOOKIES ||
+	  UIP_TCP_TW_CONNS || UIP_TCP_KEEPALIVE */
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP_SNDQ
+static void
+sndq_init(struct uip_conn *conn)
+{
+  conn->sndq = NULL;
+  conn->sndq_nxt = 0;
+  conn->sndflags = 0;
+  conn->cwnd = TCP_INITIAL_CWND;
+  conn->ssthresh = 0xff;
+  conn->cwndacc = 0;
+  conn->dupacks = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Return all segments of a connection to the pool. */
+static void
+sndq_free(struct uip_conn *conn)
+{
+  struct uip_sndseg *seg;
+
+  while(conn->sndq != NULL) {
+    seg = conn->sndq;
+    conn->sndq = seg->next;
+    seg->next = sndseg_free;
+    sndseg_free = seg;
+  }
+  sndq_init(conn);
+}
+/*---------------------------------------------------------------------------*/
+static u8_t
+sndq_count(struct uip_conn *conn)
+{
+  struct uip_sndseg *seg;
+  u8_t n;
+
+  n = 0;
+  for(seg = conn->sndq; seg != NULL; seg = seg->next) {
+    ++n;
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+/* The number of queued bytes that have been sent. */
+static u16_t
+sndq_sentlen(struct uip_conn *conn)
+{
+  struct uip_sndseg *seg;
+  u16_t len;
+  u8_t n;
+
+  len = 0;
+  for(seg = conn->sndq, n = conn->sndq_nxt; n > 0; seg = seg->next, --n) {
+    len += seg->len;
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+/* Check if a queued segment that has not been sent yet may be sent
+   now. The congestion window limits the number of segments in
+   flight. */
+static u8_t
+sndq_sendable(struct uip_conn *conn)
+{
+  return conn->sndq_nxt < sndq_count(conn) && conn->sndq_nxt < conn->cwnd;
+}
+/*---------------------------------------------------------------------------*/
+/* Halve the congestion window after a loss, based on the number of
+   segments in flight (RFC 5681). */
+static void
+sndq_cwnd_cut(struct uip_conn *conn)
+{
+  UIP_STAT(++uip_stat.tcp.cwndcut);
+  conn->ssthresh = conn->sndq_nxt / 2;
+  if(conn->ssthresh < 2) {
+    conn->ssthresh = 2;
+  }
+  conn->cwndacc = 0;
+  conn->dupacks = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Open the congestion window for an acknowledgement of new data:
+   one segment per ACK in slow start, one segment per window in
+   congestion avoidance. */
+static void
+sndq_cwnd_open(struct uip_conn *conn)
+{
+  if(conn->cwnd >= UIP_TCP_SNDWND_SEGS) {
+    return;
+  }
+  if(conn->cwnd < conn->ssthresh) {
+    ++conn->cwnd;
+  } else if(++conn->cwndacc >= conn->cwnd) {
+    conn->cwndacc = 0;
+    ++conn->cwnd;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Check if a segment of len bytes can be queued. An empty queue
+   always takes one segment, so that a zero window is probed. */
+static u8_t
+sndq_room(struct uip_conn *conn, u16_t len)
+{
+  return sndseg_free != NULL &&
+    !(conn->sndflags & SND_CLOSEPEND) &&
+    (conn->len == 0 ||
+     (sndq_count(conn) < UIP_TCP_SNDWND_SEGS &&
+      (u32_t)conn->len + len <= conn->snd_wnd));
+}
+/*---------------------------------------------------------------------------*/
+/* Queue the len bytes at uip_sappdata. */
+static void
+sndq_add(struct uip_conn *conn, u16_t len)
+{
+  struct uip_sndseg *seg, **p;
+
+  seg = sndseg_free;
+  sndseg_free = seg->next;
+  seg->next = NULL;
+  seg->len = len;
+  memcpy(seg->data, uip_sappdata, len);
+#if UIP_SPLIT == UIP_SPLIT_ADAPTIVE
+  if(conn->len == 0) {
+    conn->sndtime = clock_time();
+  }
+#endif /* UIP_SPLIT == UIP_SPLIT_ADAPTIVE */
+
+  for(p = &conn->sndq; *p != NULL; p = &(*p)->next);
+  *p = seg;
+  conn->len += len;
+}
+/*---------------------------------------------------------------------------*/
+/* Remove acked bytes from the front of the queue. */
+static void
+sndq_ack(struct uip_conn *conn, u16_t acked)
+{
+  struct uip_sndseg *seg;
+
+  conn->len -= acked;
+  while(acked > 0 && (seg = conn->sndq) != NULL) {
+    if(acked < seg->len) {
+      /* The peer has acknowledged part of the segment. */
+      seg->len -= acked;
+      memmove(seg->data, &seg->data[acked], seg->len);
+      break;
+    }
+    acked -= seg->len;
+    conn->sndq = seg->next;
+    seg->next = sndseg_free;
+    sndseg_free = seg;
+    if(conn->sndq_nxt > 0) {
+      --conn->sndq_nxt;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* The flags that tell the application what happened to the data it
+   last sent. */
+static u8_t
+sndq_appflags(struct uip_conn *conn)
+{
+  u8_t flags;
+
+  flags = 0;
+  if(conn->sndflags & SND_ACCEPTED) {
+    flags = UIP_ACKDATA;
+  } else if((conn->sndflags & SND_REFUSED) && sndq_room(conn, conn->mss)) {
+    flags = UIP_REXMIT;
+  } else {
+    return 0;
+  }
+  conn->sndflags &= ~(SND_ACCEPTED | SND_REFUSED);
+  return flags;
+}
+#endif /* UIP_TCP_SNDQ */
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP_OOQ
+/* Return all out-of-order segments of a connection to the pool. */
+static void
+ooq_free(struct uip_conn *conn)
+{
+  struct uip_ooseg *seg;
+
+  while(conn->ooq != NULL) {
+    seg = conn->ooq;
+    conn->ooq = seg->next;
+    seg->next = ooseg_free;
+    ooseg_free = seg;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Queue the len bytes at data, which start at sequence number seq. A
+   segment that starts at the same sequence number as a queued one, or
+   that does not fit in the pool, is dropped; the peer will send it
+   again. */
+static void
+ooq_add(struct uip_conn *conn, u32_t seq, const u8_t *data, u16_t len)
+{
+  struct uip_ooseg *seg, **p;
+
+  for(p = &conn->ooq; *p != NULL && SEQ_LT((*p)->seq, seq); p = &(*p)->next);
+  if(ooseg_free == NULL || (*p != NULL && (*p)->seq == seq)) {
+    return;
+  }
+  UIP_STAT(++uip_stat.tcp.ooseg);
+
+  seg = ooseg_free;
+  ooseg_free = seg->next;
+  seg->seq = seq;
+  seg->len = len;
+  memcpy(seg->data, data, len);
+  seg->next = *p;
+  *p = seg;
+}
+/*---------------------------------------------------------------------------*/
+/* Non-zero if the first queued segment starts at or before rcv_nxt. */
+static u8_t
+ooq_ready(struct uip_conn *conn)
+{
+  return conn->ooq != NULL && !SEQ_LT(RCV_NXT(conn), conn->ooq->seq);
+}
+/*---------------------------------------------------------------------------*/
+/* Copy the queued data that starts at rcv_nxt to uip_appdata and
+   return its length. Queued data that has already been received is
+   thrown away. The caller updates rcv_nxt. */
+static u16_t
+ooq_pull(struct uip_conn *conn)
+{
+  struct uip_ooseg *seg;
+  u16_t len;
+
+  len = 0;
+  while(len == 0 && ooq_ready(conn)) {
+    seg = conn->ooq;
+    tmp32 = RCV_NXT(conn) - seg->seq;
+    if(tmp32 < seg->len) {
+      len = seg->len - (u16_t)tmp32;
+      memcpy(uip_appdata, &seg->data[tmp32], len);
+    }
+    conn->ooq = seg->next;
+    seg->next = ooseg_free;
+    ooseg_free = seg;
+  }
+  return len;
+}
+#endif /* UIP_TCP_OOQ */
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP_APPSTATE_POOL
+void *
+uip_appstate_alloc(struct uip_conn *conn, struct memb_blocks *m)
+{
+  if(conn->appstate != NULL) {
+    memb_free(conn->apppool, conn->appstate);
+  }
+  conn->appstate = memb_alloc(m);
+  conn->apppool = m;
+  return conn->appstate;
+}
+/*---------------------------------------------------------------------------*/
+/* Return the application state of a connection to its pool once the
+   application will not be called for the connection again, i.e., when
+   it is CLOSED or in TIME_WAIT. */
+static void
+tcp_appstate_free(struct uip_conn *conn)
+{
+  if(conn->appstate != NULL &&
+     (conn->tcpstateflags == UIP_CLOSED ||
+      conn->tcpstateflags == UIP_TIME_WAIT)) {
+    memb_free(conn->apppool, conn->appstate);
+    conn->appstate = NULL;
+  }
+}
+#endif /* UIP_TCP_APPSTATE_POOL */
+/*---------------------------------------------------------------------------*/
+/* Close a connection and remove it from the connection hash table. All
+   transitions to the CLOSED state go through here. */
+static void
+tcp_conn_free(struct uip_conn *conn)
+{
+  struct uip_conn **p;
+
+  if(conn->tcpstateflags == UIP_CLOSED) {
+    return;
+  }
+#if UIP_TCP_SNDQ
+  sndq_free(conn);
+#endif /* UIP_TCP_SNDQ */
+#if UIP_TCP_OOQ
+  ooq_free(conn);
+#endif /* UIP_TCP_OOQ */
+  for(p = &tcp_hashtab[tcp_hash(conn->ripaddr, conn->rport, conn->lport)];
+      *p != NULL; p = &(*p)->hnext) {
+    if(*p == conn) {
+      *p = conn->hnext;
+      break;
+    }
+  }
+  conn->tcpstateflags = UIP_CLOSED;
+  conn->hnext = tcp_freelist;
+  tcp_freelist = conn;
+  ++tcp_nfree;
+}
+/*---------------------------------------------------------------------------*/
+/* Take an unused connection for a new connection. If there are no
+   CLOSED connections, the one that has been in TIME_WAIT the longest
+   is closed and used. Returns NULL if all connections are in use. */
+static struct uip_conn *
+tcp_conn_alloc(void)
+{
+  struct uip_conn *conn;
+#if !UIP_TCP_TW_CONNS
+  struct uip_conn *cconn;
+
+  if(tcp_freelist == NULL) {
+    conn = NULL;
+    for(cconn = &uip_conns[0]; cconn <= &uip_conns[UIP_CONNS - 1];
+	++cconn) {
+      if(cconn->tcpstateflags == UIP_TIME_WAIT &&
+	 (conn == NULL || cconn->timer > conn->timer)) {
+	conn = cconn;
+      }
+    }
+    if(conn != NULL) {
+      tcp_conn_free(conn);
+    }
+  }
+#endif /* !UIP_TCP_TW_CONNS */
+
+  conn = tcp_freelist;
+  if(conn != NULL) {
+    tcp_freelist = conn->hnext;
+    --tcp_nfree;
+  }
+  return conn;
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP_TW_CONNS
+/* Move a connection that has entered FIN_WAIT_2 or TIME_WAIT to
+   tcp_twconns, in place of the oldest entry if there is no free one,
+   and free the connection. The entry is left in twconn. */
+static void
+tcp_tw_enter(struct uip_conn *conn, u8_t state)
+{
+  struct uip_twconn *tw;
+
+  twconn = &tcp_twconns[0];
+  for(tw = &tcp_twconns[0]; tw <= &tcp_twconns[UIP_TCP_TW_CONNS - 1]; ++tw) {
+    if(tw->state == UIP_CLOSED) {
+      twconn = tw;
+      break;
+    }
+    if(tw->timer > twconn->timer) {
+      twconn = tw;
+    }
+  }
+
+  uip_ipaddr_copy(twconn->ripaddr, conn->ripaddr);
+  twconn->lport = conn->lport;
+  twconn->rport = conn->rport;
+  twconn->snd_nxt = SND_NXT(conn);
+  twconn->rcv_nxt = RCV_NXT(conn);
+#if UIP_TCP_TIMESTAMPS
+  twconn->ts_recent = conn->ts_recent;
+  twconn->tcpopts = conn->tcpopts;
+#endif /* UIP_TCP_TIMESTAMPS */
+  twconn->state = state;
+  twconn->timer = 0;
+  tcp_conn_free(conn);
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_tw_periodic(void)
+{
+  struct uip_twconn *tw;
+
+  for(tw = &tcp_twconns[0]; tw <= &tcp_twconns[UIP_TCP_TW_CONNS - 1]; ++tw) {
+    if(tw->state != UIP_CLOSED && ++tw->timer == UIP_TIME_WAIT_TIMEOUT) {
+      tw->state = UIP_CLOSED;
+    }
+  }
+}
+#endif /* UIP_TCP_TW_CONNS */
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP_FINE_RTO
+/* Make uip_rexmit_due() wait for the time t, if it is earlier than
+   what it waits for already. */
+static void
+rexmit_note(u32_t t)
+{
+  if(!rexmit_armed || ((u32_t)(t - rexmit_next) & 0x80000000UL)) {
+    rexmit_next = t;
+    rexmit_armed = 1;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Start the retransmission timer of a connection, to expire t clock
+   ticks from now. */
+static void
+tcp_timer_set(struct uip_conn *conn, u16_t t)
+{
+  conn->rtx_time = (u32_t)clock_time() + t;
+  rexmit_note(conn->rtx_time);
+}
+/*---------------------------------------------------------------------------*/
+u8_t
+uip_rexmit_due(void)
+{
+  register struct uip_conn *conn;
+
+  if(!rexmit_armed || !CLOCK_REACHED(rexmit_next)) {
+    return 0;
+  }
+
+  /* Wait for the earliest of the timers that have not expired yet.
+     The expired ones are started again when they are serviced. */
+  rexmit_armed = 0;
+  for(conn = &uip_conns[0]; conn <= &uip_conns[UIP_CONNS - 1]; ++conn) {
+    if(conn->tcpstateflags != UIP_CLOSED && uip_outstanding(conn) &&
+       !CLOCK_REACHED(conn->rtx_time)) {
+      rexmit_note(conn->rtx_time);
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+u8_t
+uip_rexmit_pending(struct uip_conn *conn)
+{
+  return conn->tcpstateflags != UIP_CLOSED &&
+    conn->tcpstateflags != UIP_TIME_WAIT &&
+    conn->tcpstateflags != UIP_FIN_WAIT_2 &&
+    uip_outstanding(conn) && CLOCK_REACHED(conn->rtx_time);
+}
+#endif /* UIP_TCP_FINE_RTO */
+/*---------------------------------------------------------------------------*/
 void
 uip_init(void)
 {
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
     uip_listenports[c] = 0;
   }
+  for(c = 0; c < UIP_LISTEN_HASH_SIZE; ++c) {
+    listen_hashtab[c] = 0;
+  }
+  tcp_freelist = NULL;
+  for(c = UIP_CONNS; c > 0; --c) {
+    uip_conns[c - 1].tcpstateflags = UIP_CLOSED;
+    uip_conns[c - 1].pollreq = 0;
+#if UIP_TCP_APPSTATE_POOL
+    uip_conns[c - 1].appstate = NULL;
+#endif /* UIP_TCP_APPSTATE_POOL */
+    uip_conns[c - 1].hnext = tcp_freelist;
+    tcp_freelist = &uip_conns[c - 1];
+  }
+  tcp_nfree = UIP_CONNS;
+  for(c = 0; c < UIP_TCP_HASH_SIZE; ++c) {
+    tcp_hashtab[c] = NULL;
+  }
+#if UIP_TCP_SNDQ
+  sndseg_free = NULL;
+  for(c = 0; c < UIP_TCP_SNDQ_SEGS; ++c) {
+    sndsegs[c].next = sndseg_free;
+    sndseg_free = &sndsegs[c];
+  }
   for(c = 0; c < UIP_CONNS; ++c) {
-    uip_conns[c].tcpstateflags = UIP_CLOSED;
+    sndq_init(&uip_conns[c]);
+  }
+#endif /* UIP_TCP_SNDQ */
+#if UIP_TCP_OOQ
+  ooseg_free = NULL;
+  for(c = 0; c < UIP_TCP_OOQ_SEGS; ++c) {
+    oosegs[c].next = ooseg_free;
+    ooseg_free = &oosegs[c];
+  }
+  for(c = 0; c < UIP_CONNS; ++c) {
+    uip_conns[c].ooq = NULL;
+  }
+#endif /* UIP_TCP_OOQ */
+#if UIP_TCP_TW_CONNS
+  for(c = 0; c < UIP_TCP_TW_CONNS; ++c) {
+    tcp_twconns[c].state = UIP_CLOSED;
   }
+#endif /* UIP_TCP_TW_CONNS */
+  uip_pollreqs = 0;
+#if UIP_TCP_FINE_RTO
+  rexmit_armed = 0;
+#endif /* UIP_TCP_FINE_RTO */
 #if UIP_ACTIVE_OPEN
   lastport = 1024;
+  tcp_portnext = 0;
 #endif /* UIP_ACTIVE_OPEN */
 
 #if UIP_UDP
@@ -403,66 +1163,110 @@ uip_init(void)
 }
 /*---------------------------------------------------------------------------*/
 #if UIP_ACTIVE_OPEN
-struct uip_conn *
-uip_connect(uip_ipaddr_t *ripaddr, u16_t rport)
+/* Non-zero if there is a connection, or one in FIN_WAIT_2 or
+   TIME_WAIT, with the given remote IP address and port and local
+   port. */
+static u8_t
+tcp_conn_find(u16_t *ripaddr, u16_t rport, u16_t lport)
 {
-  register struct uip_conn *conn, *cconn;
-  
-  /* Find an unused local port. */
- again:
-  ++lastport;
-
-  if(lastport >= 32000) {
-    lastport = 4096;
-  }
-
-  /* Check if this port is already in use, and if so try to find
-     another one. */
-  for(c = 0; c < UIP_CONNS; ++c) {
-    conn = &uip_conns[c];
-    if(conn->tcpstateflags != UIP_CLOSED &&
-       conn->lport == htons(lastport)) {
-      goto again;
+  struct uip_conn *conn;
+#if UIP_TCP_TW_CONNS
+  struct uip_twconn *tw;
+#endif /* UIP_TCP_TW_CONNS */
+
+  for(conn = tcp_hashtab[tcp_hash(ripaddr, rport, lport)];
+      conn != NULL; conn = conn->hnext) {
+    if(conn->lport == lport && conn->rport == rport &&
+       uip_ipaddr_cmp(conn->ripaddr, ripaddr)) {
+      return 1;
     }
   }
-
-  conn = 0;
-  for(c = 0; c < UIP_CONNS; ++c) {
-    cconn = &uip_conns[c];
-    if(cconn->tcpstateflags == UIP_CLOSED) {
-      conn = cconn;
-      break;
-    }
-    if(cconn->tcpstateflags == UIP_TIME_WAIT) {
-      if(conn == 0 ||
-	 cconn->timer > conn->timer) {
-	conn = cconn;
-      }
+#if UIP_TCP_TW_CONNS
+  for(tw = &tcp_twconns[0]; tw <= &tcp_twconns[UIP_TCP_TW_CONNS - 1]; ++tw) {
+    if(tw->state != UIP_CLOSED && tw->lport == lport &&
+       tw->rport == rport && uip_ipaddr_cmp(tw->ripaddr, ripaddr)) {
+      return 1;
     }
   }
+#endif /* UIP_TCP_TW_CONNS */
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+struct uip_conn *
+uip_connect(uip_ipaddr_t *ripaddr, u16_t rport)
+{
+  register struct uip_conn *conn;
+  u16_t port, offset;
 
+  conn = tcp_conn_alloc();
   if(conn == 0) {
     return 0;
   }
-  
+
+  /* Find a local port that is not used for a connection to the same
+     remote port. The ports are tried in sequence from an offset that
+     depends on the remote end, so a remote end does not see a local
+     port again until the range has been used up. The offset is
+     keyed by uip_portkey, so it cannot be told from the remote end
+     alone. Every connection rules out at most one port, so this ends
+     after a few tries. */
+  offset = (IPADDR_FOLD(*ripaddr) ^ rport) * (u16_t)(uip_portkey | 1) +
+    (u16_t)(uip_portkey >> 16);
+  do {
+    port = htons(UIP_TCP_PORT_MIN +
+		 (u16_t)(offset + tcp_portnext++) %
+		 (UIP_TCP_PORT_MAX - UIP_TCP_PORT_MIN + 1));
+  } while(tcp_conn_find(*ripaddr, rport, port));
+  conn->lport = port;
+
   conn->tcpstateflags = UIP_SYN_SENT;
+#if UIP_TCP_SNDQ
+  conn->snd_wnd = 0;
+#endif /* UIP_TCP_SNDQ */
 
+#if UIP_TCP_SEQ32
+  conn->snd_nxt = iss;
+#else /* UIP_TCP_SEQ32 */
   conn->snd_nxt[0] = iss[0];
   conn->snd_nxt[1] = iss[1];
   conn->snd_nxt[2] = iss[2];
   conn->snd_nxt[3] = iss[3];
+#endif /* UIP_TCP_SEQ32 */
 
   conn->initialmss = conn->mss = UIP_TCP_MSS;
+#if UIP_TCP_WSCALE || UIP_TCP_TIMESTAMPS
+  conn->tcpopts = TCP_OPTS_OFFER;
+#endif /* UIP_TCP_WSCALE || UIP_TCP_TIMESTAMPS */
+#if UIP_TCP_TIMESTAMPS
+  conn->ts_recent = 0;
+#endif /* UIP_TCP_TIMESTAMPS */
   
   conn->len = 1;   /* TCP length of the SYN is one. */
   conn->nrtx = 0;
-  conn->timer = 1; /* Send the SYN next time around. */
+#if UIP_TCP_FINE_RTO
+  conn->rto = UIP_TCP_RTO_INIT;
+  conn->sa = conn->sv = 0;
+  conn->rtt_left = 0;
+  tcp_timer_set(conn, 0); /* Send the SYN when the timer is serviced
+			     if it is not polled before. */
+#else /* UIP_TCP_FINE_RTO */
+  conn->timer = 1; /* Send the SYN next time around if it is not
+		      polled before. */
   conn->rto = UIP_RTO;
   conn->sa = 0;
   conn->sv = 16;   /* Initial value of the RTT variance. */
-  conn->lport = htons(lastport);
+#endif /* UIP_TCP_FINE_RTO */
+#if UIP_SPLIT == UIP_SPLIT_ADAPTIVE
+  conn->delack = 0;
+#endif /* UIP_SPLIT == UIP_SPLIT_ADAPTIVE */
+  TCP_IDLE_RESET(conn);
   conn->rport = rport;
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
+  tcp_hash_add(conn);
+
+  /* The SYN is sent when the main loop polls the connection, or when
+     the retransmission timer expires if it does not. */
+  uip_request_poll(conn);
   
   return conn;
 }
@@ -517,8 +1321,13 @@ uip_udp_new(uip_ipaddr_t *ripaddr, u16_t rport)
 void
 uip_unlisten(u16_t port)
 {
-  for(c = 0; c < UIP_LISTENPORTS; ++c) {
-    if(uip_listenports[c] == port) {
+  u8_t *p;
+
+  for(p = &listen_hashtab[listen_hash(port)]; *p != 0;
+      p = &listen_next[*p - 1]) {
+    if(uip_listenports[*p - 1] == port) {
+      c = *p - 1;
+      *p = listen_next[c];
       uip_listenports[c] = 0;
       return;
     }
@@ -528,9 +1337,14 @@ uip_unlisten(u16_t port)
 void
 uip_listen(u16_t port)
 {
+  u8_t h;
+
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
     if(uip_listenports[c] == 0) {
       uip_listenports[c] = port;
+      h = listen_hash(port);
+      listen_next[c] = listen_hashtab[h];
+      listen_hashtab[h] = c + 1;
       return;
     }
   }
@@ -668,14 +1482,309 @@ uip_reass(void)
 }
 #endif /* UIP_REASSEMBLY */
 /*---------------------------------------------------------------------------*/
+/* Parse the options of an incoming SYN or SYNACK for a connection.
+   The MSS of the peer is taken from its MSS option, and the options
+   that we offer in conn->tcpopts are kept only if the peer sends
+   them too (RFC 7323). Without a connection, only the MSS option is
+   parsed and returned, for a SYN cookie. */
+static u16_t
+tcp_parse_synopts(struct uip_conn *conn)
+{
+  u8_t *p;
+  u8_t hlen, i;
+  u16_t mss;
+#if UIP_TCP_WSCALE || UIP_TCP_TIMESTAMPS
+  u8_t opts;
+
+  opts = 0;
+#endif /* UIP_TCP_WSCALE || UIP_TCP_TIMESTAMPS */
+  mss = TCP_DEFAULT_MSS;
+  p = &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN];
+  hlen = (BUF->tcpoffset >> 4) << 2;
+  for(i = UIP_TCPH_LEN; i < hlen;) {
+    if(p[i] == TCP_OPT_END) {
+      /* End of options. */
+      break;
+    } else if(p[i] == TCP_OPT_NOOP) {
+      /* NOP option. */
+      ++i;
+      continue;
+    }
+    /* All other options have a length field. If it is too small or
+       too large, the options are malformed and we don't process them
+       further. */
+    if(i + 1 >= hlen || p[i + 1] < 2 || i + p[i + 1] > hlen) {
+      break;
+    }
+    if(p[i] == TCP_OPT_MSS && p[i + 1] == TCP_OPT_MSS_LEN) {
+      mss = ((u16_t)p[i + 2] << 8) | p[i + 3];
+#if UIP_TCP_WSCALE
+    } else if(p[i] == TCP_OPT_WS && p[i + 1] == TCP_OPT_WS_LEN) {
+      /* The largest scale allowed is 14. */
+      opts |= TCP_OPTS_WS | (p[i + 2] > 14? 14: p[i + 2]);
+#endif /* UIP_TCP_WSCALE */
+#if UIP_TCP_TIMESTAMPS
+    } else if(p[i] == TCP_OPT_TS && p[i + 1] == TCP_OPT_TS_LEN &&
+	      conn != NULL) {
+      opts |= TCP_OPTS_TS;
+      conn->ts_recent = seq_get(&p[i + 2]);
+#endif /* UIP_TCP_TIMESTAMPS */
+    }
+    i += p[i + 1];
+  }
+
+  if(conn == NULL) {
+    return mss;
+  }
+  if(mss > UIP_TCP_MSS) {
+    mss = UIP_TCP_MSS;
+  }
+#if UIP_TCP_WSCALE || UIP_TCP_TIMESTAMPS
+  if(!(conn->tcpopts & TCP_OPTS_WS)) {
+    opts &= ~(TCP_OPTS_WS | TCP_OPTS_WSHIFT);
+  }
+  if(!(conn->tcpopts & TCP_OPTS_TS)) {
+    opts &= ~TCP_OPTS_TS;
+  }
+  conn->tcpopts = opts;
+#endif /* UIP_TCP_WSCALE || UIP_TCP_TIMESTAMPS */
+#if UIP_TCP_TIMESTAMPS
+  if(opts & TCP_OPTS_TS) {
+    /* The timestamps take room from the data of every segment. */
+    mss -= TCP_OPT_TS_ALIGNED_LEN;
+  }
+#endif /* UIP_TCP_TIMESTAMPS */
+  conn->initialmss = conn->mss = mss;
+  return mss;
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP_TIMESTAMPS
+/* Write our timestamps option, echoing ts_recent, after two NOPs, to
+   p. */
+static void
+tcp_ts_put(u8_t *p, u32_t ts_recent)
+{
+  p[0] = TCP_OPT_NOOP;
+  p[1] = TCP_OPT_NOOP;
+  p[2] = TCP_OPT_TS;
+  p[3] = TCP_OPT_TS_LEN;
+  seq_put(&p[4], (u32_t)clock_time());
+  seq_put(&p[8], ts_recent);
+}
+/*---------------------------------------------------------------------------*/
+/* Find the timestamps option of the incoming segment, whose TCP
+   header is hlen bytes long, and read it into ts_val and ts_ecr.
+   Returns zero if there is none. */
+static u8_t
+tcp_ts_get(u8_t hlen)
+{
+  u8_t *p;
+  u8_t i;
+
+  p = &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN];
+  for(i = UIP_TCPH_LEN; i < hlen;) {
+    if(p[i] == TCP_OPT_END) {
+      break;
+    } else if(p[i] == TCP_OPT_NOOP) {
+      ++i;
+    } else if(i + 1 >= hlen || p[i + 1] < 2 || i + p[i + 1] > hlen) {
+      break;
+    } else if(p[i] == TCP_OPT_TS && p[i + 1] == TCP_OPT_TS_LEN) {
+      ts_val = seq_get(&p[i + 2]);
+      ts_ecr = seq_get(&p[i + 6]);
+      return 1;
+    } else {
+      i += p[i + 1];
+    }
+  }
+  return 0;
+}
+#endif /* UIP_TCP_TIMESTAMPS */
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP_SYNCOOKIES
+/* The MSS values that a SYN cookie can encode. */
+static const u16_t syncookie_mss[8] = {
+  64, 128, 256, 536, 1024, 1220, 1440, 1460
+};
+
+/* The time count of the SYN cookies. A cookie is accepted during the
+   period in which it was sent and the next one. */
+#define SYNCOOKIE_PERIOD (64 * CLOCK_SECOND)
+#define SYNCOOKIE_TIME() \
+  ((u8_t)((u32_t)clock_time() / SYNCOOKIE_PERIOD) & 0x1f)
+
+#define SYNCOOKIE_MIX(h, v) do {		\
+    (h) ^= (v);					\
+    (h) *= 0x9e3779b1UL;			\
+    (h) ^= (h) >> 15;				\
+  } while(0)
+
+/* Compute the SYN cookie for the connection of the segment in
+   uip_buf, whose peer has the initial sequence number isn. The top
+   five bits of the cookie are the time count, the next three the
+   index of the MSS, and the rest is a hash of these, the connection
+   and the secret. */
+static u32_t
+syncookie_make(u32_t isn, u8_t top)
+{
+  u32_t h;
+  u8_t i;
+
+  h = uip_syncookie_secret ^ top;
+  for(i = 0; i < sizeof(uip_ipaddr_t) / 2; ++i) {
+    SYNCOOKIE_MIX(h, BUF->srcipaddr[i]);
+  }
+  SYNCOOKIE_MIX(h, ((u32_t)BUF->srcport << 16) | BUF->destport);
+  SYNCOOKIE_MIX(h, isn);
+  SYNCOOKIE_MIX(h, uip_syncookie_secret);
+  return ((u32_t)top << 24) | (h & 0x00ffffff);
+}
+/*---------------------------------------------------------------------------*/
+/* Check if the ACK in uip_buf acknowledges a SYN cookie that we sent
+   recently. */
+static u8_t
+syncookie_check(void)
+{
+  u32_t cookie;
+
+  cookie = seq_get(BUF->ackno) - 1;
+  return ((SYNCOOKIE_TIME() - (u8_t)(cookie >> 27)) & 0x1f) <= 1 &&
+    syncookie_make(seq_get(BUF->seqno) - 1, cookie >> 24) == cookie;
+}
+/*---------------------------------------------------------------------------*/
+/* Turn the SYN in uip_buf into a SYNACK that carries a SYN cookie,
+   with the MSS of the peer rounded down to one that the cookie can
+   encode. */
+static void
+syncookie_synack(void)
+{
+  u32_t isn;
+  u16_t mss;
+  u8_t i;
+
+  mss = tcp_parse_synopts(NULL);
+  for(i = 7; i > 0 && syncookie_mss[i] > mss; --i);
+
+  isn = seq_get(BUF->seqno);
+  seq_put(BUF->seqno, syncookie_make(isn, (SYNCOOKIE_TIME() << 3) | i));
+  seq_put(BUF->ackno, isn + 1);
+  BUF->flags = TCP_SYN | TCP_ACK;
+  BUF->optdata[0] = TCP_OPT_MSS;
+  BUF->optdata[1] = TCP_OPT_MSS_LEN;
+  BUF->optdata[2] = (UIP_TCP_MSS) / 256;
+  BUF->optdata[3] = (UIP_TCP_MSS) & 255;
+  BUF->tcpoffset = ((UIP_TCPH_LEN + TCP_OPT_MSS_LEN) / 4) << 4;
+  uip_len = UIP_IPTCPH_LEN + TCP_OPT_MSS_LEN;
+  BUF->wnd[0] = ((UIP_RECEIVE_WINDOW) >> 8);
+  BUF->wnd[1] = ((UIP_RECEIVE_WINDOW) & 0xff);
+
+  mss = BUF->srcport;
+  BUF->srcport = BUF->destport;
+  BUF->destport = mss;
+  uip_ipaddr_copy(BUF->destipaddr, BUF->srcipaddr);
+  uip_ipaddr_copy(BUF->srcipaddr, uip_hostaddr);
+}
+#endif /* UIP_TCP_SYNCOOKIES */
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP_FINE_RTO
+/* Called when acked bytes have been acknowledged. If that covers the
+   segment being timed, its round-trip time updates the RTT estimate
+   and the RTO of the connection (RFC 6298). With timestamps, every
+   acknowledgement gives the round-trip time of the segment that it
+   answers (RFC 7323). */
+static void
+tcp_rtt_estimate(struct uip_conn *conn, u16_t acked)
+{
+  u32_t rtt;
+  short m;
+
+#if UIP_TCP_TIMESTAMPS
+  if(ts_ecr != 0) {
+    conn->rtt_left = 0;
+    rtt = (u32_t)clock_time() - ts_ecr;
+  } else
+#endif /* UIP_TCP_TIMESTAMPS */
+  {
+    if(conn->rtt_left == 0) {
+      return;
+    }
+    if(acked < conn->rtt_left) {
+      conn->rtt_left -= acked;
+      return;
+    }
+    conn->rtt_left = 0;
+    rtt = (u16_t)((u16_t)clock_time() - conn->rtt_time);
+  }
+  if(rtt > 0xfff) {
+    rtt = 0xfff;
+  }
+  if(conn->sa == 0) {
+    /* The first measurement. */
+    conn->sa = rtt << 3;
+    conn->sv = rtt << 1;
+  } else {
+    m = (short)rtt - (short)(conn->sa >> 3);
+    conn->sa += m;
+    if(m < 0) {
+      m = -m;
+    }
+    m = m - (conn->sv >> 2);
+    conn->sv += m;
+  }
+  conn->rto = (conn->sa >> 3) + conn->sv;
+  if(conn->rto < UIP_TCP_RTO_MIN) {
+    conn->rto = UIP_TCP_RTO_MIN;
+  } else if(conn->rto > UIP_TCP_RTO_MAX) {
+    conn->rto = UIP_TCP_RTO_MAX;
+  }
+}
+#else /* UIP_TCP_FINE_RTO */
+/* Update the RTT estimate and the RTO of a connection from the time
+   its retransmission timer has been running. */
+static void
+tcp_rtt_estimate(struct uip_conn *conn, u16_t acked)
+{
+  signed char m;
+
+  m = conn->rto - conn->timer;
+  /* This is taken directly from VJs original code in his paper */
+  m = m - (conn->sa >> 3);
+  conn->sa += m;
+  if(m < 0) {
+    m = -m;
+  }
+  m = m - (conn->sv >> 2);
+  conn->sv += m;
+  conn->rto = (conn->sa >> 3) + conn->sv;
+}
+#endif /* UIP_TCP_FINE_RTO */
+/*---------------------------------------------------------------------------*/
+#if UIP_SPLIT == UIP_SPLIT_ADAPTIVE
+/* Called when an acknowledgement leaves no data outstanding. A peer
+   that takes longer than UIP_SPLIT_DELACK_TIME to acknowledge the last
+   of the data is taken to delay its ACKs, and the segments of the
+   connection are split from then on. */
+static void
+delack_check(struct uip_conn *conn)
+{
+  if((u16_t)((u16_t)clock_time() - conn->sndtime) >= UIP_SPLIT_DELACK_TIME) {
+    conn->delack = 1;
+  }
+}
+#endif /* UIP_SPLIT == UIP_SPLIT_ADAPTIVE */
+/*---------------------------------------------------------------------------*/
 static void
 uip_add_rcv_nxt(u16_t n)
 {
+#if UIP_TCP_SEQ32
+  uip_conn->rcv_nxt += n;
+#else /* UIP_TCP_SEQ32 */
   uip_add32(uip_conn->rcv_nxt, n);
   uip_conn->rcv_nxt[0] = uip_acc32[0];
   uip_conn->rcv_nxt[1] = uip_acc32[1];
   uip_conn->rcv_nxt[2] = uip_acc32[2];
   uip_conn->rcv_nxt[3] = uip_acc32[3];
+#endif /* UIP_TCP_SEQ32 */
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -690,16 +1799,66 @@ uip_process(u8_t flag)
 #endif /* UIP_UDP */
   
   uip_sappdata = uip_appdata = &uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN];
+#if UIP_TCP_TIMESTAMPS
+  /* Outgoing data goes after the timestamps option. */
+  if(flag != UIP_DATA && uip_connr != NULL) {
+    uip_sappdata = uip_appdata = (u8_t *)uip_appdata + TCP_OPTLEN(uip_connr);
+  }
+#endif /* UIP_TCP_TIMESTAMPS */
 
   /* Check if we were invoked because of a poll request for a
      particular connection. */
   if(flag == UIP_POLL_REQUEST) {
+#if UIP_ACTIVE_OPEN
+    /* A connection from uip_connect() sends its SYN right away
+       instead of waiting for the timer. */
+    if(uip_connr->tcpstateflags == UIP_SYN_SENT &&
+       uip_connr->nrtx == 0) {
+      TCP_TIMER_SET(uip_connr, uip_connr->rto);
+      BUF->flags = 0;
+      goto tcp_send_syn;
+    }
+#endif /* UIP_ACTIVE_OPEN */
+#if UIP_TCP_OOQ
+    /* Queued out-of-order data that is now in sequence is delivered
+       first, one segment per poll. */
+    if(uip_connr->tcpstateflags == UIP_ESTABLISHED &&
+       (uip_len = ooq_pull(uip_connr)) > 0) {
+      uip_add_rcv_nxt(uip_len);
+      if(ooq_ready(uip_connr)) {
+	uip_request_poll(uip_connr);
+      }
+      uip_flags = UIP_NEWDATA;
+#if UIP_TCP_SNDQ
+      uip_flags |= sndq_appflags(uip_connr);
+#endif /* UIP_TCP_SNDQ */
+      uip_slen = 0;
+      UIP_APPCALL();
+      goto appsend;
+    }
+#endif /* UIP_TCP_OOQ */
+#if UIP_TCP_SNDQ
+    /* With the send queue, a poll request either continues sending
+       the queued segments or lets the application queue more data. */
+    if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+      uip_flags = 0;
+      if(sndq_sendable(uip_connr) ||
+	 (uip_connr->sndflags & SND_CLOSEPEND)) {
+	goto sndq_output;
+      }
+      uip_flags = UIP_POLL | sndq_appflags(uip_connr);
+      uip_slen = 0;
+      UIP_APPCALL();
+      goto appsend;
+    }
+#else /* UIP_TCP_SNDQ */
     if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
        !uip_outstanding(uip_connr)) {
 	uip_flags = UIP_POLL;
 	UIP_APPCALL();
 	goto appsend;
     }
+#endif /* UIP_TCP_SNDQ */
     goto drop;
     
     /* Check if we were invoked because of the perodic timer fireing. */
@@ -710,6 +1869,9 @@ uip_process(u8_t flag)
     }
 #endif /* UIP_REASSEMBLY */
     /* Increase the initial sequence number. */
+#if UIP_TCP_SEQ32
+    ++iss;
+#else /* UIP_TCP_SEQ32 */
     if(++iss[3] == 0) {
       if(++iss[2] == 0) {
 	if(++iss[1] == 0) {
@@ -717,6 +1879,7 @@ uip_process(u8_t flag)
 	}
       }
     }
+#endif /* UIP_TCP_SEQ32 */
 
     /* Reset the length variables. */
     uip_len = 0;
@@ -730,19 +1893,30 @@ uip_process(u8_t flag)
        uip_connr->tcpstateflags == UIP_FIN_WAIT_2) {
       ++(uip_connr->timer);
       if(uip_connr->timer == UIP_TIME_WAIT_TIMEOUT) {
-	uip_connr->tcpstateflags = UIP_CLOSED;
+	tcp_conn_free(uip_connr);
       }
     } else if(uip_connr->tcpstateflags != UIP_CLOSED) {
+#if UIP_TCP_KEEPALIVE || UIP_TCP_EVICT_IDLE
+      if(uip_connr->idle != 0xffff) {
+	++(uip_connr->idle);
+      }
+#endif /* UIP_TCP_KEEPALIVE || UIP_TCP_EVICT_IDLE */
       /* If the connection has outstanding data, we increase the
 	 connection's timer and see if it has reached the RTO value
 	 in which case we retransmit. */
       if(uip_outstanding(uip_connr)) {
-	if(uip_connr->timer-- == 0) {
+	if(TCP_TIMER_EXPIRED(uip_connr)) {
+#if UIP_TCP_FINE_RTO
+	tcp_rexmit:
+#endif /* UIP_TCP_FINE_RTO */
 	  if(uip_connr->nrtx == UIP_MAXRTX ||
 	     ((uip_connr->tcpstateflags == UIP_SYN_SENT ||
 	       uip_connr->tcpstateflags == UIP_SYN_RCVD) &&
 	      uip_connr->nrtx == UIP_MAXSYNRTX)) {
-	    uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_KEEPALIVE
+	  tcp_timedout:
+#endif /* UIP_TCP_KEEPALIVE */
+	    tcp_conn_free(uip_connr);
 
 	    /* We call UIP_APPCALL() with uip_flags set to
 	       UIP_TIMEDOUT to inform the application that the
@@ -756,9 +1930,20 @@ uip_process(u8_t flag)
 	  }
 
 	  /* Exponential backoff. */
+#if UIP_TCP_FINE_RTO
+	  /* The timeout is doubled for every retransmission, up to
+	     UIP_TCP_RTO_MAX, so that a short RTO does not give up on a
+	     connection after a short outage. */
+	  tmp32 = (u32_t)uip_connr->rto << (uip_connr->nrtx + 1);
+	  TCP_TIMER_SET(uip_connr, tmp32 > UIP_TCP_RTO_MAX?
+			UIP_TCP_RTO_MAX: (u16_t)tmp32);
+	  /* No RTT is measured on a retransmitted segment (Karn). */
+	  uip_connr->rtt_left = 0;
+#else /* UIP_TCP_FINE_RTO */
 	  uip_connr->timer = UIP_RTO << (uip_connr->nrtx > 4?
 					 4:
 					 uip_connr->nrtx);
+#endif /* UIP_TCP_FINE_RTO */
 	  ++(uip_connr->nrtx);
 	  
 	  /* Ok, so we need to retransmit. We do this differently
@@ -782,6 +1967,18 @@ uip_process(u8_t flag)
 #endif /* UIP_ACTIVE_OPEN */
 	    
 	  case UIP_ESTABLISHED:
+#if UIP_TCP_SNDQ
+	    /* With the send queue, we go back and resend the queued
+	       segments, starting with the oldest one. The others
+	       follow as the peer acknowledges the first, in slow
+	       start from a congestion window of one segment. */
+	    sndq_cwnd_cut(uip_connr);
+	    uip_connr->cwnd = 1;
+	    uip_connr->sndflags &= ~(SND_RECOVERY | SND_REXMIT);
+	    uip_connr->sndq_nxt = 0;
+	    uip_flags = 0;
+	    goto sndq_output;
+#else /* UIP_TCP_SNDQ */
 	    /* In the ESTABLISHED state, we call upon the application
                to do the actual retransmit after which we jump into
                the code for sending out the packet (the apprexmit
@@ -789,6 +1986,7 @@ uip_process(u8_t flag)
 	    uip_flags = UIP_REXMIT;
 	    UIP_APPCALL();
 	    goto apprexmit;
+#endif /* UIP_TCP_SNDQ */
 	    
 	  case UIP_FIN_WAIT_1:
 	  case UIP_CLOSING:
@@ -799,15 +1997,45 @@ uip_process(u8_t flag)
 	  }
 	}
       } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+#if UIP_TCP_KEEPALIVE
+	/* If the connection has been idle for too long, we send a
+	   keepalive probe instead, or give up on the connection if
+	   the probes have gone unanswered. */
+	if(uip_connr->idle >= UIP_TCP_KEEPIDLE +
+	   (u16_t)uip_connr->kaprobes * UIP_TCP_KEEPINTVL) {
+	  if(uip_connr->kaprobes == UIP_TCP_KEEPCNT) {
+	    goto tcp_timedout;
+	  }
+	  ++(uip_connr->kaprobes);
+	  UIP_STAT(++uip_stat.tcp.keepalive);
+	  goto tcp_send_keepalive;
+	}
+#endif /* UIP_TCP_KEEPALIVE */
 	/* If there was no need for a retransmission, we poll the
            application for new data. */
 	uip_flags = UIP_POLL;
+#if UIP_TCP_SNDQ
+	uip_flags |= sndq_appflags(uip_connr);
+	uip_slen = 0;
+#endif /* UIP_TCP_SNDQ */
 	UIP_APPCALL();
 	goto appsend;
       }
     }
     goto drop;
   }
+#if UIP_TCP_FINE_RTO
+  /* Check if we were invoked because the retransmission timer of a
+     connection expired between the periodic timer pulses. */
+  if(flag == UIP_REXMIT_TIMER) {
+    uip_len = 0;
+    uip_slen = 0;
+    if(uip_rexmit_pending(uip_connr)) {
+      goto tcp_rexmit;
+    }
+    goto drop;
+  }
+#endif /* UIP_TCP_FINE_RTO */
 #if UIP_UDP
   if(flag == UIP_UDP_TIMER) {
     if(uip_udp_conn->lport != 0) {
@@ -994,12 +2222,9 @@ uip_process(u8_t flag)
 #endif /* UIP_PINGADDRCONF */
 
   ICMPBUF->type = ICMP_ECHO_REPLY;
-
-  if(ICMPBUF->icmpchksum >= HTONS(0xffff - (ICMP_ECHO << 8))) {
-    ICMPBUF->icmpchksum += HTONS(ICMP_ECHO << 8) + 1;
-  } else {
-    ICMPBUF->icmpchksum += HTONS(ICMP_ECHO << 8);
-  }
+  ICMPBUF->icmpchksum = uip_chksum_adjust(ICMPBUF->icmpchksum,
+					  HTONS(ICMP_ECHO << 8),
+					  HTONS(ICMP_ECHO_REPLY << 8));
 
   /* Swap IP addresses. */
   uip_ipaddr_copy(BUF->destipaddr, BUF->srcipaddr);
@@ -1175,6 +2400,27 @@ uip_process(u8_t flag)
 
   /* Start of TCP input header processing code. */
   
+#if UIP_RX_CHKSUM
+  if(uip_rxsum_valid) {
+    /* The driver has summed the TCP header and data while copying the
+       packet, so only the pseudo header is left to add. */
+    u32_t sum;
+
+    uip_rxsum_valid = 0;
+    sum = ntohs(uip_chksum((u16_t *)&BUF->srcipaddr[0],
+			   2 * sizeof(uip_ipaddr_t)));
+    sum += (((u16_t)BUF->len[0] << 8) + BUF->len[1]) - UIP_IPH_LEN;
+    sum += UIP_PROTO_TCP + uip_rxsum;
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    if(sum != 0xffff) {
+      UIP_STAT(++uip_stat.tcp.drop);
+      UIP_STAT(++uip_stat.tcp.chkerr);
+      UIP_LOG("tcp: bad checksum.");
+      goto drop;
+    }
+  } else
+#endif /* UIP_RX_CHKSUM */
   if(uip_tcpchksum() != 0xffff) {   /* Compute and check the TCP
 				       checksum. */
     UIP_STAT(++uip_stat.tcp.drop);
@@ -1184,30 +2430,116 @@ uip_process(u8_t flag)
   }
   
   
+#if UIP_TCP_TIMESTAMPS
+  ts_ecr = 0;
+#endif /* UIP_TCP_TIMESTAMPS */
+
+#if UIP_TCP_HDRPRED
+  /* Header prediction: the common case is the next segment for the
+     connection that received the previous one, carrying an ACK and
+     possibly data, but no other flags and no options other than the
+     timestamps that the connection uses. Such segments skip the
+     lookup and the header checks below, and go directly to the ACK
+     processing. A stopped connection has other bits set in its state
+     and takes the generic path. */
+  uip_connr = tcp_lastconn;
+  if(uip_connr != NULL &&
+     uip_connr->tcpstateflags == UIP_ESTABLISHED &&
+     (BUF->flags & (TCP_CTL & ~TCP_PSH)) == TCP_ACK &&
+#if UIP_TCP_TIMESTAMPS
+     ((uip_connr->tcpopts & TCP_OPTS_TS)?
+      (BUF->tcpoffset ==
+       ((UIP_TCPH_LEN + TCP_OPT_TS_ALIGNED_LEN) / 4) << 4 &&
+       tcp_ts_get(UIP_TCPH_LEN + TCP_OPT_TS_ALIGNED_LEN) &&
+       !SEQ_LT(ts_val, uip_connr->ts_recent)):
+      BUF->tcpoffset == (UIP_TCPH_LEN / 4) << 4) &&
+#else /* UIP_TCP_TIMESTAMPS */
+     BUF->tcpoffset == (UIP_TCPH_LEN / 4) << 4 &&
+#endif /* UIP_TCP_TIMESTAMPS */
+     BUF->destport == uip_connr->lport &&
+     BUF->srcport == uip_connr->rport &&
+     uip_ipaddr_cmp(BUF->srcipaddr, uip_connr->ripaddr) &&
+#if UIP_TCP_SEQ32
+     seq_get(BUF->seqno) == uip_connr->rcv_nxt
+#else /* UIP_TCP_SEQ32 */
+     BUF->seqno[0] == uip_connr->rcv_nxt[0] &&
+     BUF->seqno[1] == uip_connr->rcv_nxt[1] &&
+     BUF->seqno[2] == uip_connr->rcv_nxt[2] &&
+     BUF->seqno[3] == uip_connr->rcv_nxt[3]
+#endif /* UIP_TCP_SEQ32 */
+     ) {
+    UIP_STAT(++uip_stat.tcp.predhit);
+    uip_conn = uip_connr;
+    uip_flags = 0;
+    TCP_IDLE_RESET(uip_connr);
+#if UIP_TCP_TIMESTAMPS
+    if(uip_connr->tcpopts & TCP_OPTS_TS) {
+      uip_connr->ts_recent = ts_val;
+      uip_len -= TCP_OPT_TS_ALIGNED_LEN;
+      uip_appdata = uip_sappdata =
+	&uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN + TCP_OPT_TS_ALIGNED_LEN];
+    }
+#endif /* UIP_TCP_TIMESTAMPS */
+    uip_len = uip_len - UIP_IPTCPH_LEN;
+    goto tcp_ack;
+  }
+#endif /* UIP_TCP_HDRPRED */
+
   /* Demultiplex this segment. */
-  /* First check any active connections. */
-  for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
-      ++uip_connr) {
-    if(uip_connr->tcpstateflags != UIP_CLOSED &&
-       BUF->destport == uip_connr->lport &&
+  /* First check any active connections. Only connections that are
+     not CLOSED are in the hash table. */
+  for(uip_connr = tcp_hashtab[tcp_hash(BUF->srcipaddr, BUF->srcport,
+				       BUF->destport)];
+      uip_connr != NULL; uip_connr = uip_connr->hnext) {
+    if(BUF->destport == uip_connr->lport &&
        BUF->srcport == uip_connr->rport &&
        uip_ipaddr_cmp(BUF->srcipaddr, uip_connr->ripaddr)) {
       goto found;
     }
   }
 
+#if UIP_TCP_TW_CONNS
+  /* Then the connections in FIN_WAIT_2 and TIME_WAIT. A SYN beyond
+     the sequence numbers of a connection in TIME_WAIT ends it, and
+     may start a new connection (RFC 1122, 4.2.2.13). */
+  for(twconn = &tcp_twconns[0];
+      twconn <= &tcp_twconns[UIP_TCP_TW_CONNS - 1]; ++twconn) {
+    if(twconn->state != UIP_CLOSED &&
+       BUF->destport == twconn->lport &&
+       BUF->srcport == twconn->rport &&
+       uip_ipaddr_cmp(BUF->srcipaddr, twconn->ripaddr)) {
+      if((BUF->flags & TCP_CTL) != TCP_SYN ||
+	 twconn->state != UIP_TIME_WAIT ||
+	 SEQ_LT(seq_get(BUF->seqno), twconn->rcv_nxt)) {
+	goto found_tw;
+      }
+      twconn->state = UIP_CLOSED;
+      break;
+    }
+  }
+#endif /* UIP_TCP_TW_CONNS */
+
   /* If we didn't find and active connection that expected the packet,
      either this packet is an old duplicate, or this is a SYN packet
      destined for a connection in LISTEN. If the SYN flag isn't set,
-     it is an old packet and we send a RST. */
+     it is an old packet and we send a RST. With SYN cookies, it may
+     also be the ACK that completes a handshake for a connection in
+     LISTEN. */
+#if UIP_TCP_SYNCOOKIES
+  if((BUF->flags & TCP_CTL) != TCP_SYN &&
+     (BUF->flags & (TCP_SYN | TCP_RST | TCP_ACK)) != TCP_ACK) {
+    goto reset;
+  }
+#else /* UIP_TCP_SYNCOOKIES */
   if((BUF->flags & TCP_CTL) != TCP_SYN) {
     goto reset;
   }
+#endif /* UIP_TCP_SYNCOOKIES */
   
   tmp16 = BUF->destport;
   /* Next, check listening connections. */
-  for(c = 0; c < UIP_LISTENPORTS; ++c) {
-    if(tmp16 == uip_listenports[c])
+  for(c = listen_hashtab[listen_hash(tmp16)]; c != 0; c = listen_next[c - 1]) {
+    if(tmp16 == uip_listenports[c - 1])
       goto found_listen;
   }
   
@@ -1221,11 +2553,67 @@ uip_process(u8_t flag)
   }
 
   UIP_STAT(++uip_stat.tcp.rst);
+
+#if !UIP_CONF_IPV6
+  /* The incoming segment has passed the checksum test, so instead of
+     computing the checksum of the RST from scratch, we update the
+     checksum of the incoming segment for the fields that change (see
+     RFC1624). Swapping the ports, the addresses and the sequence
+     numbers does not change the checksum. First remove the options
+     and data, and adjust the length in the pseudo header. */
+  tmp16 = ((u16_t)BUF->len[0] << 8) + BUF->len[1] - UIP_IPTCPH_LEN;
+  if(tmp16 > 0) {
+    BUF->tcpchksum =
+      uip_chksum_adjust(BUF->tcpchksum,
+			uip_chksum((u16_t *)&uip_buf[UIP_LLH_LEN + UIP_IPTCPH_LEN],
+				   tmp16), 0);
+  }
+  BUF->tcpchksum = uip_chksum_adjust(BUF->tcpchksum,
+				     HTONS(tmp16 + UIP_TCPH_LEN),
+				     HTONS(UIP_TCPH_LEN));
+  BUF->tcpchksum = uip_chksum_adjust(BUF->tcpchksum,
+				     HTONS((BUF->urgp[0] << 8) | BUF->urgp[1]), 0);
+  BUF->tcpchksum = uip_chksum_adjust(BUF->tcpchksum,
+				     HTONS((BUF->tcpoffset << 8) | BUF->flags),
+				     HTONS(((UIP_TCPH_LEN / 4) << 12) |
+					   TCP_RST | TCP_ACK));
+  /* The source address of the RST is our own address, which normally
+     is the destination address of the incoming segment. */
+  BUF->tcpchksum = uip_chksum_adjust(BUF->tcpchksum,
+				     BUF->destipaddr[0], uip_hostaddr[0]);
+  BUF->tcpchksum = uip_chksum_adjust(BUF->tcpchksum,
+				     BUF->destipaddr[1], uip_hostaddr[1]);
+  /* The acknowledgement number of the RST is the incoming sequence
+     number plus one. */
+#if UIP_TCP_SEQ32
+  tmp32 = seq_get(BUF->seqno);
+  BUF->tcpchksum = uip_chksum_adjust(BUF->tcpchksum,
+				     HTONS(tmp32 >> 16), HTONS((tmp32 + 1) >> 16));
+  BUF->tcpchksum = uip_chksum_adjust(BUF->tcpchksum,
+				     HTONS(tmp32 & 0xffff),
+				     HTONS((tmp32 + 1) & 0xffff));
+#else /* UIP_TCP_SEQ32 */
+  uip_add32(BUF->seqno, 1);
+  BUF->tcpchksum = uip_chksum_adjust(BUF->tcpchksum,
+				     HTONS((BUF->seqno[0] << 8) | BUF->seqno[1]),
+				     HTONS((uip_acc32[0] << 8) | uip_acc32[1]));
+  BUF->tcpchksum = uip_chksum_adjust(BUF->tcpchksum,
+				     HTONS((BUF->seqno[2] << 8) | BUF->seqno[3]),
+				     HTONS((uip_acc32[2] << 8) | uip_acc32[3]));
+#endif /* UIP_TCP_SEQ32 */
+#endif /* !UIP_CONF_IPV6 */
   
   BUF->flags = TCP_RST | TCP_ACK;
   uip_len = UIP_IPTCPH_LEN;
   BUF->tcpoffset = 5 << 4;
 
+#if UIP_TCP_SEQ32
+  /* Flip the seqno and ackno fields in the TCP header. We also have
+     to increase the sequence number we are acknowledging. */
+  tmp32 = seq_get(BUF->seqno);
+  memcpy(BUF->seqno, BUF->ackno, 4);
+  seq_put(BUF->ackno, tmp32 + 1);
+#else /* UIP_TCP_SEQ32 */
   /* Flip the seqno and ackno fields in the TCP header. */
   c = BUF->seqno[3];
   BUF->seqno[3] = BUF->ackno[3];
@@ -1253,6 +2641,7 @@ uip_process(u8_t flag)
       }
     }
   }
+#endif /* UIP_TCP_SEQ32 */
  
   /* Swap port numbers. */
   tmp16 = BUF->srcport;
@@ -1264,7 +2653,15 @@ uip_process(u8_t flag)
   uip_ipaddr_copy(BUF->srcipaddr, uip_hostaddr);
   
   /* And send out the RST packet! */
+#if UIP_CONF_IPV6
   goto tcp_send_noconn;
+#else /* UIP_CONF_IPV6 */
+  BUF->ttl = UIP_TTL;
+  BUF->len[0] = (uip_len >> 8);
+  BUF->len[1] = (uip_len & 0xff);
+  BUF->urgp[0] = BUF->urgp[1] = 0;
+  goto ip_send_nolen;
+#endif /* UIP_CONF_IPV6 */
 
   /* This label will be jumped to if we matched the incoming packet
      with a connection in LISTEN. In that case, we should create a new
@@ -1272,23 +2669,62 @@ uip_process(u8_t flag)
  found_listen:
   /* First we check if there are any connections avaliable. Unused
      connections are kept in the same table as used connections, but
-     unused ones have the tcpstate set to CLOSED. Also, connections in
-     TIME_WAIT are kept track of and we'll use the oldest one if no
-     CLOSED connections are found. Thanks to Eddie C. Dost for a very
-     nice algorithm for the TIME_WAIT search. */
-  uip_connr = 0;
+     unused ones have the tcpstate set to CLOSED and are kept on
+     tcp_freelist. If there are none, tcp_conn_alloc() uses the oldest
+     connection in TIME_WAIT. */
+#if UIP_TCP_SYNCOOKIES
+  /* With SYN cookies, we first count the connections that could be
+     used. */
+  tmp16 = tcp_nfree;
+#if !UIP_TCP_TW_CONNS
   for(c = 0; c < UIP_CONNS; ++c) {
-    if(uip_conns[c].tcpstateflags == UIP_CLOSED) {
-      uip_connr = &uip_conns[c];
-      break;
-    }
     if(uip_conns[c].tcpstateflags == UIP_TIME_WAIT) {
-      if(uip_connr == 0 ||
-	 uip_conns[c].timer > uip_connr->timer) {
+      ++tmp16;
+    }
+  }
+#endif /* !UIP_TCP_TW_CONNS */
+
+  if(BUF->flags & TCP_SYN) {
+    if(tmp16 <= UIP_TCP_SYNCOOKIE_THRESHOLD) {
+      /* Leave the remaining connections to the peers that complete
+	 the handshake. */
+      UIP_STAT(++uip_stat.tcp.cookiesent);
+      syncookie_synack();
+      goto tcp_send_noconn;
+    }
+  } else if(!syncookie_check()) {
+    UIP_STAT(++uip_stat.tcp.cookiebad);
+    goto reset;
+  }
+#endif /* UIP_TCP_SYNCOOKIES */
+  uip_connr = tcp_conn_alloc();
+
+#if UIP_TCP_EVICT_IDLE
+  if(uip_connr == 0) {
+    /* All connections are used, so we evict the one that has been
+       idle the longest, if it has been idle long enough. */
+    for(c = 0; c < UIP_CONNS; ++c) {
+      if(uip_conns[c].tcpstateflags == UIP_ESTABLISHED &&
+	 !uip_outstanding(&uip_conns[c]) &&
+	 uip_conns[c].idle >= UIP_TCP_EVICT_IDLE &&
+	 (uip_connr == 0 || uip_conns[c].idle > uip_connr->idle)) {
 	uip_connr = &uip_conns[c];
       }
     }
+    if(uip_connr != 0) {
+      UIP_STAT(++uip_stat.tcp.evicted);
+      UIP_LOG("tcp: evicting idle connection.");
+      tcp_conn_free(uip_connr);
+      uip_conn = uip_connr;
+      uip_flags = UIP_ABORT;
+      UIP_APPCALL();
+#if UIP_TCP_APPSTATE_POOL
+      tcp_appstate_free(uip_connr);
+#endif /* UIP_TCP_APPSTATE_POOL */
+      uip_connr = tcp_conn_alloc();
+    }
   }
+#endif /* UIP_TCP_EVICT_IDLE */
 
   if(uip_connr == 0) {
     /* All connections are used already, we drop packet and hope that
@@ -1301,60 +2737,79 @@ uip_process(u8_t flag)
   uip_conn = uip_connr;
   
   /* Fill in the necessary fields for the new connection. */
+#if UIP_TCP_FINE_RTO
+  uip_connr->rto = UIP_TCP_RTO_INIT;
+  uip_connr->sa = uip_connr->sv = 0;
+  uip_connr->rtt_left = 0;
+  tcp_timer_set(uip_connr, uip_connr->rto);
+#else /* UIP_TCP_FINE_RTO */
   uip_connr->rto = uip_connr->timer = UIP_RTO;
   uip_connr->sa = 0;
   uip_connr->sv = 4;
+#endif /* UIP_TCP_FINE_RTO */
   uip_connr->nrtx = 0;
+#if UIP_SPLIT == UIP_SPLIT_ADAPTIVE
+  uip_connr->delack = 0;
+#endif /* UIP_SPLIT == UIP_SPLIT_ADAPTIVE */
+  TCP_IDLE_RESET(uip_connr);
   uip_connr->lport = BUF->destport;
   uip_connr->rport = BUF->srcport;
   uip_ipaddr_copy(uip_connr->ripaddr, BUF->srcipaddr);
   uip_connr->tcpstateflags = UIP_SYN_RCVD;
-
+  tcp_hash_add(uip_connr);
+#if UIP_TCP_SNDQ
+  uip_connr->snd_wnd = ((u16_t)BUF->wnd[0] << 8) + BUF->wnd[1];
+#endif /* UIP_TCP_SNDQ */
+
+#if UIP_TCP_SEQ32
+  uip_connr->snd_nxt = iss;
+#else /* UIP_TCP_SEQ32 */
   uip_connr->snd_nxt[0] = iss[0];
   uip_connr->snd_nxt[1] = iss[1];
   uip_connr->snd_nxt[2] = iss[2];
   uip_connr->snd_nxt[3] = iss[3];
+#endif /* UIP_TCP_SEQ32 */
   uip_connr->len = 1;
 
   /* rcv_nxt should be the seqno from the incoming packet + 1. */
+#if UIP_TCP_SEQ32
+  uip_connr->rcv_nxt = seq_get(BUF->seqno) + 1;
+#else /* UIP_TCP_SEQ32 */
   uip_connr->rcv_nxt[3] = BUF->seqno[3];
   uip_connr->rcv_nxt[2] = BUF->seqno[2];
   uip_connr->rcv_nxt[1] = BUF->seqno[1];
   uip_connr->rcv_nxt[0] = BUF->seqno[0];
   uip_add_rcv_nxt(1);
-
-  /* Parse the TCP MSS option, if present. */
-  if((BUF->tcpoffset & 0xf0) > 0x50) {
-    for(c = 0; c < ((BUF->tcpoffset >> 4) - 5) << 2 ;) {
-      opt = uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + c];
-      if(opt == TCP_OPT_END) {
-	/* End of options. */
-	break;
-      } else if(opt == TCP_OPT_NOOP) {
-	++c;
-	/* NOP option. */
-      } else if(opt == TCP_OPT_MSS &&
-		uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c] == TCP_OPT_MSS_LEN) {
-	/* An MSS option with the right option length. */
-	tmp16 = ((u16_t)uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 2 + c] << 8) |
-	  (u16_t)uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN + 3 + c];
-	uip_connr->initialmss = uip_connr->mss =
-	  tmp16 > UIP_TCP_MSS? UIP_TCP_MSS: tmp16;
-	
-	/* And we are done processing options. */
-	break;
-      } else {
-	/* All other options have a length field, so that we easily
-	   can skip past them. */
-	if(uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c] == 0) {
-	  /* If the length field is zero, the options are malformed
-	     and we don't process them further. */
-	  break;
-	}
-	c += uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c];
-      }
+#endif /* UIP_TCP_SEQ32 */
+
+#if UIP_TCP_SYNCOOKIES
+  if(!(BUF->flags & TCP_SYN)) {
+    /* The connection was answered with the SYN cookie that the ACK
+       acknowledges. The ACK is then processed as in SYN_RCVD. */
+#if UIP_TCP_SEQ32
+    uip_connr->snd_nxt = seq_get(BUF->ackno) - 1;
+    uip_connr->rcv_nxt = seq_get(BUF->seqno);
+#else /* UIP_TCP_SEQ32 */
+    seq_put(uip_connr->snd_nxt, seq_get(BUF->ackno) - 1);
+    seq_put(uip_connr->rcv_nxt, seq_get(BUF->seqno));
+#endif /* UIP_TCP_SEQ32 */
+    uip_connr->mss = syncookie_mss[((seq_get(BUF->ackno) - 1) >> 24) & 7];
+    if(uip_connr->mss > UIP_TCP_MSS) {
+      uip_connr->mss = UIP_TCP_MSS;
     }
+    uip_connr->initialmss = uip_connr->mss;
+#if UIP_TCP_WSCALE || UIP_TCP_TIMESTAMPS
+    uip_connr->tcpopts = 0;
+#endif /* UIP_TCP_WSCALE || UIP_TCP_TIMESTAMPS */
+    goto found;
   }
+#endif /* UIP_TCP_SYNCOOKIES */
+
+  /* Parse the TCP options, and agree to those that we support. */
+#if UIP_TCP_WSCALE || UIP_TCP_TIMESTAMPS
+  uip_connr->tcpopts = TCP_OPTS_OFFER;
+#endif /* UIP_TCP_WSCALE || UIP_TCP_TIMESTAMPS */
+  tcp_parse_synopts(uip_connr);
   
   /* Our response will be a SYNACK. */
 #if UIP_ACTIVE_OPEN
@@ -1375,19 +2830,91 @@ uip_process(u8_t flag)
   BUF->optdata[2] = (UIP_TCP_MSS) / 256;
   BUF->optdata[3] = (UIP_TCP_MSS) & 255;
   uip_len = UIP_IPTCPH_LEN + TCP_OPT_MSS_LEN;
-  BUF->tcpoffset = ((UIP_TCPH_LEN + TCP_OPT_MSS_LEN) / 4) << 4;
+#if UIP_TCP_WSCALE
+  /* Our own window is not scaled, but the option lets the peer scale
+     its window. */
+  if(uip_connr->tcpopts & TCP_OPTS_WS) {
+    uip_buf[UIP_LLH_LEN + uip_len] = TCP_OPT_NOOP;
+    uip_buf[UIP_LLH_LEN + uip_len + 1] = TCP_OPT_WS;
+    uip_buf[UIP_LLH_LEN + uip_len + 2] = TCP_OPT_WS_LEN;
+    uip_buf[UIP_LLH_LEN + uip_len + 3] = 0;
+    uip_len += 4;
+  }
+#endif /* UIP_TCP_WSCALE */
+#if UIP_TCP_TIMESTAMPS
+  if(uip_connr->tcpopts & TCP_OPTS_TS) {
+    tcp_ts_put(&uip_buf[UIP_LLH_LEN + uip_len], uip_connr->ts_recent);
+    uip_len += TCP_OPT_TS_ALIGNED_LEN;
+  }
+#endif /* UIP_TCP_TIMESTAMPS */
+  BUF->tcpoffset = ((uip_len - UIP_IPH_LEN) / 4) << 4;
   goto tcp_send;
 
+#if UIP_TCP_TW_CONNS
+  /* This label will be jumped to if we found a connection in
+     FIN_WAIT_2 or TIME_WAIT. The application has closed the
+     connection, so the data of the peer is acknowledged and thrown
+     away. */
+ found_tw:
+  if(BUF->flags & TCP_RST) {
+    twconn->state = UIP_CLOSED;
+    goto drop;
+  }
+  c = (BUF->tcpoffset >> 4) << 2;
+  uip_len = uip_len - c - UIP_IPH_LEN;
+  if(twconn->state == UIP_FIN_WAIT_2 &&
+     seq_get(BUF->seqno) == twconn->rcv_nxt) {
+    twconn->rcv_nxt += uip_len;
+    if(BUF->flags & TCP_FIN) {
+      ++twconn->rcv_nxt;
+      twconn->state = UIP_TIME_WAIT;
+      twconn->timer = 0;
+    }
+  }
+  if(uip_len == 0 && !(BUF->flags & (TCP_SYN | TCP_FIN))) {
+    goto drop;
+  }
+
+  /* Acknowledge the segment in uip_buf for the connection in
+     twconn. The ACK is made from the segment in place, as a RST
+     is. */
+ tw_send_ack:
+  seq_put(BUF->seqno, twconn->snd_nxt);
+  seq_put(BUF->ackno, twconn->rcv_nxt);
+  BUF->flags = TCP_ACK;
+  BUF->tcpoffset = (UIP_TCPH_LEN / 4) << 4;
+  uip_len = UIP_IPTCPH_LEN;
+#if UIP_TCP_TIMESTAMPS
+  if(twconn->tcpopts & TCP_OPTS_TS) {
+    tcp_ts_put(&uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN], twconn->ts_recent);
+    uip_len += TCP_OPT_TS_ALIGNED_LEN;
+    BUF->tcpoffset = ((UIP_TCPH_LEN + TCP_OPT_TS_ALIGNED_LEN) / 4) << 4;
+  }
+#endif /* UIP_TCP_TIMESTAMPS */
+  BUF->wnd[0] = ((UIP_RECEIVE_WINDOW) >> 8);
+  BUF->wnd[1] = ((UIP_RECEIVE_WINDOW) & 0xff);
+
+  tmp16 = BUF->srcport;
+  BUF->srcport = BUF->destport;
+  BUF->destport = tmp16;
+  uip_ipaddr_copy(BUF->destipaddr, BUF->srcipaddr);
+  uip_ipaddr_copy(BUF->srcipaddr, uip_hostaddr);
+  goto tcp_send_noconn;
+#endif /* UIP_TCP_TW_CONNS */
+
   /* This label will be jumped to if we found an active connection. */
  found:
   uip_conn = uip_connr;
   uip_flags = 0;
+#if UIP_TCP_HDRPRED
+  tcp_lastconn = uip_connr;
+#endif /* UIP_TCP_HDRPRED */
   /* We do a very naive form of TCP reset processing; we just accept
      any RST and kill our connection. We should in fact check if the
      sequence number of this reset is wihtin our advertised window
      before we accept the reset. */
   if(BUF->flags & TCP_RST) {
-    uip_connr->tcpstateflags = UIP_CLOSED;
+    tcp_conn_free(uip_connr);
     UIP_LOG("tcp: got reset, aborting connection.");
     uip_flags = UIP_ABORT;
     UIP_APPCALL();
@@ -1400,6 +2927,30 @@ uip_process(u8_t flag)
      calculated by subtracing the length of the TCP header (in
      c) and the length of the IP header (20 bytes). */
   uip_len = uip_len - c - UIP_IPH_LEN;
+  /* The data follows the options. */
+  uip_appdata = &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN + c];
+
+#if UIP_TCP_TIMESTAMPS
+  if(uip_connr->tcpopts & TCP_OPTS_TS) {
+    uip_sappdata = (u8_t *)uip_sappdata + TCP_OPT_TS_ALIGNED_LEN;
+    /* A segment with a timestamp older than the last one is an old
+       duplicate, from before the sequence numbers wrapped (PAWS, RFC
+       7323). Otherwise, the timestamp of the next segment in sequence
+       is the one to echo. */
+    ts_ecr = 0;
+    if((uip_connr->tcpstateflags & UIP_TS_MASK) != UIP_SYN_SENT &&
+       tcp_ts_get(c)) {
+      if(SEQ_LT(ts_val, uip_connr->ts_recent)) {
+	UIP_STAT(++uip_stat.tcp.paws);
+	goto tcp_send_ack;
+      }
+      if(seq_get(BUF->seqno) == RCV_NXT(uip_connr)) {
+	uip_connr->ts_recent = ts_val;
+      }
+    }
+  }
+#endif /* UIP_TCP_TIMESTAMPS */
+  TCP_IDLE_RESET(uip_connr);
 
   /* First, check if the sequence number of the incoming packet is
      what we're expecting next. If not, we send out an ACK with the
@@ -1407,10 +2958,30 @@ uip_process(u8_t flag)
   if(!(((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_SYN_SENT) &&
        ((BUF->flags & TCP_CTL) == (TCP_SYN | TCP_ACK)))) {
     if((uip_len > 0 || ((BUF->flags & (TCP_SYN | TCP_FIN)) != 0)) &&
+#if UIP_TCP_SEQ32
+       seq_get(BUF->seqno) != uip_connr->rcv_nxt
+#else /* UIP_TCP_SEQ32 */
        (BUF->seqno[0] != uip_connr->rcv_nxt[0] ||
 	BUF->seqno[1] != uip_connr->rcv_nxt[1] ||
 	BUF->seqno[2] != uip_connr->rcv_nxt[2] ||
-	BUF->seqno[3] != uip_connr->rcv_nxt[3])) {
+	BUF->seqno[3] != uip_connr->rcv_nxt[3])
+#endif /* UIP_TCP_SEQ32 */
+       ) {
+#if UIP_TCP_OOQ
+      /* Keep data that arrives ahead of what we expect, if all of it
+	 is within our window. The ACK below tells the peer which
+	 data is missing. */
+      if(uip_connr->tcpstateflags == UIP_ESTABLISHED &&
+	 uip_len > 0 && uip_len <= UIP_TCP_MSS &&
+	 (BUF->flags & (TCP_SYN | TCP_FIN)) == 0) {
+	tmp32 = seq_get(BUF->seqno) - RCV_NXT(uip_connr);
+	if(tmp32 < UIP_RECEIVE_WINDOW &&
+	   tmp32 + uip_len <= UIP_RECEIVE_WINDOW) {
+	  ooq_add(uip_connr, seq_get(BUF->seqno),
+		  &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN + c], uip_len);
+	}
+      }
+#endif /* UIP_TCP_OOQ */
       goto tcp_send_ack;
     }
   }
@@ -1419,7 +2990,16 @@ uip_process(u8_t flag)
      data. If so, we update the sequence number, reset the length of
      the outstanding data, calculate RTT estimations, and reset the
      retransmission timer. */
-  if((BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
+#if UIP_TCP_HDRPRED
+ tcp_ack:
+#endif /* UIP_TCP_HDRPRED */
+  if((BUF->flags & TCP_ACK) && uip_outstanding(uip_connr) &&
+     SNDQ_EMPTY(uip_connr)) {
+#if UIP_TCP_SEQ32
+    if(seq_get(BUF->ackno) == uip_connr->snd_nxt + uip_connr->len) {
+      /* Update sequence number. */
+      uip_connr->snd_nxt += uip_connr->len;
+#else /* UIP_TCP_SEQ32 */
     uip_add32(uip_connr->snd_nxt, uip_connr->len);
 
     if(BUF->ackno[0] == uip_acc32[0] &&
@@ -1431,33 +3011,104 @@ uip_process(u8_t flag)
       uip_connr->snd_nxt[1] = uip_acc32[1];
       uip_connr->snd_nxt[2] = uip_acc32[2];
       uip_connr->snd_nxt[3] = uip_acc32[3];
+#endif /* UIP_TCP_SEQ32 */
 	
 
       /* Do RTT estimation, unless we have done retransmissions. */
-      if(uip_connr->nrtx == 0) {
-	signed char m;
-	m = uip_connr->rto - uip_connr->timer;
-	/* This is taken directly from VJs original code in his paper */
-	m = m - (uip_connr->sa >> 3);
-	uip_connr->sa += m;
-	if(m < 0) {
-	  m = -m;
+      if(TCP_RTT_OK(uip_connr)) {
+	tcp_rtt_estimate(uip_connr, uip_connr->len);
+#if UIP_SPLIT == UIP_SPLIT_ADAPTIVE
+	/* The send time is only kept for data. */
+	if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+	  delack_check(uip_connr);
 	}
-	m = m - (uip_connr->sv >> 2);
-	uip_connr->sv += m;
-	uip_connr->rto = (uip_connr->sa >> 3) + uip_connr->sv;
-
+#endif /* UIP_SPLIT == UIP_SPLIT_ADAPTIVE */
       }
       /* Set the acknowledged flag. */
       uip_flags = UIP_ACKDATA;
       /* Reset the retransmission timer. */
-      uip_connr->timer = uip_connr->rto;
+      TCP_TIMER_SET(uip_connr, uip_connr->rto);
 
       /* Reset length of outstanding data. */
       uip_connr->len = 0;
     }
     
   }
+#if UIP_TCP_SNDQ
+  else if((BUF->flags & TCP_ACK) && uip_connr->sndq != NULL) {
+    /* An acknowledgement for queued data may cover any number of the
+       segments in flight. The application is not told about it,
+       since it was told when its data was queued. */
+#if UIP_TCP_SEQ32
+    tmp32 = seq_get(BUF->ackno) - uip_connr->snd_nxt;
+    if(tmp32 > 0 && tmp32 <= uip_connr->len) {
+      uip_connr->snd_nxt += tmp32;
+#else /* UIP_TCP_SEQ32 */
+    tmp32 = seq_get(BUF->ackno) - seq_get(uip_connr->snd_nxt);
+    if(tmp32 > 0 && tmp32 <= uip_connr->len) {
+      uip_add32(uip_connr->snd_nxt, (u16_t)tmp32);
+      uip_connr->snd_nxt[0] = uip_acc32[0];
+      uip_connr->snd_nxt[1] = uip_acc32[1];
+      uip_connr->snd_nxt[2] = uip_acc32[2];
+      uip_connr->snd_nxt[3] = uip_acc32[3];
+#endif /* UIP_TCP_SEQ32 */
+      sndq_ack(uip_connr, (u16_t)tmp32);
+      uip_connr->dupacks = 0;
+
+      if(uip_connr->sndflags & SND_RECOVERY) {
+	/* NewReno (RFC 6582): an ACK that does not cover all data that
+	   was in flight when the loss was detected means that the next
+	   segment was lost too, and it is sent again at once. A full
+	   ACK ends the recovery and deflates the window. */
+	if(tmp32 < uip_connr->recover) {
+	  uip_connr->recover -= (u16_t)tmp32;
+	  uip_connr->sndflags |= SND_REXMIT;
+	} else {
+	  uip_connr->sndflags &= ~SND_RECOVERY;
+	  uip_connr->cwnd = uip_connr->ssthresh;
+	}
+      } else {
+	sndq_cwnd_open(uip_connr);
+      }
+
+      if(TCP_RTT_OK(uip_connr) && !(uip_connr->sndflags & SND_RECOVERY)) {
+	tcp_rtt_estimate(uip_connr, (u16_t)tmp32);
+#if UIP_SPLIT == UIP_SPLIT_ADAPTIVE
+	/* Only the wait for the last acknowledgement tells if the
+	   peer delays its ACKs. */
+	if(uip_connr->len == 0) {
+	  delack_check(uip_connr);
+	} else {
+	  uip_connr->sndtime = clock_time();
+	}
+#endif /* UIP_SPLIT == UIP_SPLIT_ADAPTIVE */
+      }
+      TCP_TIMER_SET(uip_connr, uip_connr->rto);
+      uip_connr->nrtx = 0;
+    } else if(tmp32 == 0 && uip_len == 0 && uip_connr->sndq_nxt > 0 &&
+	      (BUF->flags & (TCP_SYN | TCP_FIN)) == 0) {
+      /* A duplicate ACK. The third one in a row is taken as a sign
+	 that the oldest segment was lost, and it is sent again
+	 without waiting for the retransmission timer (RFC 5681). In
+	 fast recovery, each further duplicate ACK means that a
+	 segment has left the network, and lets another one in. */
+      if(uip_connr->sndflags & SND_RECOVERY) {
+	if(uip_connr->cwnd < UIP_TCP_SNDWND_SEGS) {
+	  ++uip_connr->cwnd;
+	}
+      } else if(++uip_connr->dupacks == 3) {
+	UIP_STAT(++uip_stat.tcp.fastrexmit);
+	sndq_cwnd_cut(uip_connr);
+	uip_connr->cwnd = uip_connr->ssthresh;
+	uip_connr->recover = sndq_sentlen(uip_connr);
+	uip_connr->sndflags |= SND_RECOVERY | SND_REXMIT;
+#if UIP_TCP_FINE_RTO
+	uip_connr->rtt_left = 0;
+#endif /* UIP_TCP_FINE_RTO */
+      }
+    }
+  }
+#endif /* UIP_TCP_SNDQ */
 
   /* Do different things depending on in what state the connection is. */
   switch(uip_connr->tcpstateflags & UIP_TS_MASK) {
@@ -1492,44 +3143,23 @@ uip_process(u8_t flag)
     if((uip_flags & UIP_ACKDATA) &&
        (BUF->flags & TCP_CTL) == (TCP_SYN | TCP_ACK)) {
 
-      /* Parse the TCP MSS option, if present. */
-      if((BUF->tcpoffset & 0xf0) > 0x50) {
-	for(c = 0; c < ((BUF->tcpoffset >> 4) - 5) << 2 ;) {
-	  opt = uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN + c];
-	  if(opt == TCP_OPT_END) {
-	    /* End of options. */
-	    break;
-	  } else if(opt == TCP_OPT_NOOP) {
-	    ++c;
-	    /* NOP option. */
-	  } else if(opt == TCP_OPT_MSS &&
-		    uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c] == TCP_OPT_MSS_LEN) {
-	    /* An MSS option with the right option length. */
-	    tmp16 = (uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 2 + c] << 8) |
-	      uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 3 + c];
-	    uip_connr->initialmss =
-	      uip_connr->mss = tmp16 > UIP_TCP_MSS? UIP_TCP_MSS: tmp16;
-
-	    /* And we are done processing options. */
-	    break;
-	  } else {
-	    /* All other options have a length field, so that we easily
-	       can skip past them. */
-	    if(uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c] == 0) {
-	      /* If the length field is zero, the options are malformed
-		 and we don't process them further. */
-	      break;
-	    }
-	    c += uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c];
-	  }
-	}
-      }
+      /* Parse the TCP options, and give up those of ours that the
+	 peer did not agree to. */
+      tcp_parse_synopts(uip_connr);
+#if UIP_TCP_TIMESTAMPS
+      uip_sappdata = uip_appdata =
+	&uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN + TCP_OPTLEN(uip_connr)];
+#endif /* UIP_TCP_TIMESTAMPS */
       uip_connr->tcpstateflags = UIP_ESTABLISHED;
+#if UIP_TCP_SEQ32
+      uip_connr->rcv_nxt = seq_get(BUF->seqno) + 1;
+#else /* UIP_TCP_SEQ32 */
       uip_connr->rcv_nxt[0] = BUF->seqno[0];
       uip_connr->rcv_nxt[1] = BUF->seqno[1];
       uip_connr->rcv_nxt[2] = BUF->seqno[2];
       uip_connr->rcv_nxt[3] = BUF->seqno[3];
       uip_add_rcv_nxt(1);
+#endif /* UIP_TCP_SEQ32 */
       uip_flags = UIP_CONNECTED | UIP_NEWDATA;
       uip_connr->len = 0;
       uip_len = 0;
@@ -1541,7 +3171,7 @@ uip_process(u8_t flag)
     uip_flags = UIP_ABORT;
     UIP_APPCALL();
     /* The connection is closed after we send the RST */
-    uip_conn->tcpstateflags = UIP_CLOSED;
+    tcp_conn_free(uip_conn);
     goto reset;
 #endif /* UIP_ACTIVE_OPEN */
     
@@ -1570,6 +3200,7 @@ uip_process(u8_t flag)
       uip_connr->len = 1;
       uip_connr->tcpstateflags = UIP_LAST_ACK;
       uip_connr->nrtx = 0;
+      TCP_TIMER_SET(uip_connr, uip_connr->rto);
     tcp_send_finack:
       BUF->flags = TCP_FIN | TCP_ACK;
       goto tcp_send_nodata;
@@ -1604,6 +3235,13 @@ uip_process(u8_t flag)
     if(uip_len > 0 && !(uip_connr->tcpstateflags & UIP_STOPPED)) {
       uip_flags |= UIP_NEWDATA;
       uip_add_rcv_nxt(uip_len);
+#if UIP_TCP_OOQ
+      /* If this segment filled a gap, the queued data that follows
+	 it is delivered when the connection is polled. */
+      if(ooq_ready(uip_connr)) {
+	uip_request_poll(uip_connr);
+      }
+#endif /* UIP_TCP_OOQ */
     }
 
     /* Check if the available buffer space advertised by the other end
@@ -1619,11 +3257,26 @@ uip_process(u8_t flag)
        "persistent timer" and uses the retransmission mechanim.
     */
     tmp16 = ((u16_t)BUF->wnd[0] << 8) + (u16_t)BUF->wnd[1];
+#if UIP_TCP_WSCALE
+    /* Scale the window, and cap it at what fits in 16 bits. */
+    if((uip_connr->tcpopts & TCP_OPTS_WSHIFT) != 0) {
+      tmp16 = (tmp16 >> (16 - (uip_connr->tcpopts & TCP_OPTS_WSHIFT))) != 0?
+	0xffff: tmp16 << (uip_connr->tcpopts & TCP_OPTS_WSHIFT);
+    }
+#endif /* UIP_TCP_WSCALE */
+#if UIP_TCP_SNDQ
+    /* With the send queue, the window limits the amount of queued
+       data instead. The MSS is left alone so that the application
+       always knows how much of its data a segment took. */
+    uip_connr->snd_wnd = tmp16;
+    uip_flags |= sndq_appflags(uip_connr);
+#else /* UIP_TCP_SNDQ */
     if(tmp16 > uip_connr->initialmss ||
        tmp16 == 0) {
       tmp16 = uip_connr->initialmss;
     }
     uip_connr->mss = tmp16;
+#endif /* UIP_TCP_SNDQ */
 
     /* If this packet constitutes an ACK for outstanding data (flagged
        by the UIP_ACKDATA flag, we should call the application since it
@@ -1641,7 +3294,7 @@ uip_process(u8_t flag)
        put into the uip_appdata and the length of the data should be
        put into uip_len. If the application don't have any data to
        send, uip_len must be set to 0. */
-    if(uip_flags & (UIP_NEWDATA | UIP_ACKDATA)) {
+    if(uip_flags & (UIP_NEWDATA | UIP_ACKDATA | UIP_REXMIT)) {
       uip_slen = 0;
       UIP_APPCALL();
 
@@ -1649,16 +3302,46 @@ uip_process(u8_t flag)
       
       if(uip_flags & UIP_ABORT) {
 	uip_slen = 0;
-	uip_connr->tcpstateflags = UIP_CLOSED;
+	tcp_conn_free(uip_connr);
 	BUF->flags = TCP_RST | TCP_ACK;
 	goto tcp_send_nodata;
       }
 
+#if UIP_TCP_SNDQ
+      if(uip_flags & UIP_CLOSE) {
+	/* The FIN is sent by sndq_output once all queued data has
+	   been acknowledged. */
+	uip_slen = 0;
+	uip_connr->sndflags |= SND_CLOSEPEND;
+      }
+
+      if(uip_slen > 0) {
+	if(uip_slen > uip_connr->mss) {
+	  uip_slen = uip_connr->mss;
+	}
+	if(sndq_room(uip_connr, uip_slen)) {
+	  if(uip_connr->len == 0) {
+	    TCP_TIMER_SET(uip_connr, uip_connr->rto);
+	    uip_connr->nrtx = 0;
+	  }
+	  sndq_add(uip_connr, uip_slen);
+	  /* Poll the application soon, to tell it that the data was
+	     accepted. */
+	  uip_connr->sndflags |= SND_ACCEPTED;
+	  uip_request_poll(uip_connr);
+	} else {
+	  uip_connr->sndflags |= SND_REFUSED;
+	}
+      }
+      goto sndq_output;
+#else /* UIP_TCP_SNDQ */
+
       if(uip_flags & UIP_CLOSE) {
 	uip_slen = 0;
 	uip_connr->len = 1;
 	uip_connr->tcpstateflags = UIP_FIN_WAIT_1;
 	uip_connr->nrtx = 0;
+	TCP_TIMER_SET(uip_connr, uip_connr->rto);
 	BUF->flags = TCP_FIN | TCP_ACK;
 	goto tcp_send_nodata;
       }
@@ -1687,6 +3370,10 @@ uip_process(u8_t flag)
 	  /* Remember how much data we send out now so that we know
 	     when everything has been acknowledged. */
 	  uip_connr->len = uip_slen;
+	  TCP_TIMER_SET(uip_connr, uip_connr->rto);
+#if UIP_SPLIT == UIP_SPLIT_ADAPTIVE
+	  uip_connr->sndtime = clock_time();
+#endif /* UIP_SPLIT == UIP_SPLIT_ADAPTIVE */
 	} else {
 
 	  /* If the application already had unacknowledged data, we
@@ -1709,6 +3396,7 @@ uip_process(u8_t flag)
 	/* Send the packet. */
 	goto tcp_send_noopts;
       }
+#endif /* UIP_TCP_SNDQ */
       /* If there is no data to send, just send out a pure ACK if
 	 there is newdata. */
       if(uip_flags & UIP_NEWDATA) {
@@ -1717,12 +3405,63 @@ uip_process(u8_t flag)
 	goto tcp_send_noopts;
       }
     }
+#if UIP_TCP_SNDQ
+  sndq_output:
+    /* A close that was deferred until all queued data had been
+       acknowledged. */
+    if((uip_connr->sndflags & SND_CLOSEPEND) && uip_connr->len == 0) {
+      uip_connr->sndflags &= ~SND_CLOSEPEND;
+      uip_connr->len = 1;
+      uip_connr->tcpstateflags = UIP_FIN_WAIT_1;
+      uip_connr->nrtx = 0;
+      TCP_TIMER_SET(uip_connr, uip_connr->rto);
+      BUF->flags = TCP_FIN | TCP_ACK;
+      goto tcp_send_nodata;
+    }
+
+    /* Send the oldest queued segment that has not been sent yet, or
+       the oldest one again after a fast retransmit. The rest are sent
+       through poll requests as far as the congestion window allows,
+       except after a timeout where they follow one per
+       acknowledgement. */
+    if((uip_connr->sndflags & SND_REXMIT) && uip_connr->sndq != NULL) {
+      uip_connr->sndflags &= ~SND_REXMIT;
+      UIP_STAT(++uip_stat.tcp.rexmit);
+      sndoff = 0;
+      sndseg = uip_connr->sndq;
+      goto sndq_send;
+    }
+    c = uip_connr->sndq_nxt;
+    if(sndq_sendable(uip_connr)) {
+      sndoff = 0;
+      for(sndseg = uip_connr->sndq; c > 0; sndseg = sndseg->next, --c) {
+	sndoff += sndseg->len;
+      }
+      ++uip_connr->sndq_nxt;
+      if(uip_connr->nrtx == 0 && sndq_sendable(uip_connr)) {
+	uip_request_poll(uip_connr);
+      }
+    sndq_send:
+      uip_appdata = uip_sappdata;
+      memcpy(uip_appdata, sndseg->data, sndseg->len);
+      uip_len = sndseg->len + UIP_TCPIP_HLEN;
+      BUF->flags = TCP_ACK | TCP_PSH;
+      BUF->tcpoffset = (UIP_TCPH_LEN / 4) << 4;
+      goto tcp_send_sndoff;
+    }
+
+    if(uip_flags & UIP_NEWDATA) {
+      uip_len = UIP_TCPIP_HLEN;
+      BUF->flags = TCP_ACK;
+      goto tcp_send_noopts;
+    }
+#endif /* UIP_TCP_SNDQ */
     goto drop;
   case UIP_LAST_ACK:
     /* We can close this connection if the peer has acknowledged our
        FIN. This is indicated by the UIP_ACKDATA flag. */
     if(uip_flags & UIP_ACKDATA) {
-      uip_connr->tcpstateflags = UIP_CLOSED;
+      tcp_conn_free(uip_connr);
       uip_flags = UIP_CLOSE;
       UIP_APPCALL();
     }
@@ -1746,10 +3485,27 @@ uip_process(u8_t flag)
       uip_add_rcv_nxt(1);
       uip_flags = UIP_CLOSE;
       UIP_APPCALL();
+#if UIP_TCP_TW_CONNS
+      if(uip_connr->tcpstateflags == UIP_TIME_WAIT) {
+	tcp_tw_enter(uip_connr, UIP_TIME_WAIT);
+	goto tw_send_ack;
+      }
+#endif /* UIP_TCP_TW_CONNS */
       goto tcp_send_ack;
     } else if(uip_flags & UIP_ACKDATA) {
+#if UIP_TCP_TW_CONNS
+      /* The application is told now, since the connection leaves
+	 uip_conns. */
+      uip_flags = UIP_CLOSE;
+      UIP_APPCALL();
+      tcp_tw_enter(uip_connr, UIP_FIN_WAIT_2);
+      if(uip_len > 0) {
+	goto tw_send_ack;
+      }
+#else /* UIP_TCP_TW_CONNS */
       uip_connr->tcpstateflags = UIP_FIN_WAIT_2;
       uip_connr->len = 0;
+#endif /* UIP_TCP_TW_CONNS */
       goto drop;
     }
     if(uip_len > 0) {
@@ -1779,12 +3535,30 @@ uip_process(u8_t flag)
     
   case UIP_CLOSING:
     if(uip_flags & UIP_ACKDATA) {
+#if UIP_TCP_TW_CONNS
+      tcp_tw_enter(uip_connr, UIP_TIME_WAIT);
+#else /* UIP_TCP_TW_CONNS */
       uip_connr->tcpstateflags = UIP_TIME_WAIT;
       uip_connr->timer = 0;
+#endif /* UIP_TCP_TW_CONNS */
     }
   }
   goto drop;
   
+#if UIP_TCP_KEEPALIVE
+  /* A keepalive probe is an ACK with the sequence number of the last
+     byte that the peer has acknowledged, which the peer answers with
+     an ACK of its own. */
+ tcp_send_keepalive:
+  BUF->flags = TCP_ACK;
+  uip_len = UIP_IPTCPH_LEN;
+  BUF->tcpoffset = (UIP_TCPH_LEN / 4) << 4;
+  seq_put(BUF->seqno, SND_NXT(uip_connr) - 1);
+#if UIP_TCP_SNDQ
+  sndoff = 0;
+#endif /* UIP_TCP_SNDQ */
+  goto tcp_send_seqno;
+#endif /* UIP_TCP_KEEPALIVE */
 
   /* We jump here when we are ready to send the packet, and just want
      to set the appropriate TCP sequence numbers in the TCP header. */
@@ -1799,15 +3573,61 @@ uip_process(u8_t flag)
      reply. Our job is to fill in all the fields of the TCP and IP
      headers before calculating the checksum and finally send the
      packet. */
-  BUF->ackno[0] = uip_connr->rcv_nxt[0];
-  BUF->ackno[1] = uip_connr->rcv_nxt[1];
-  BUF->ackno[2] = uip_connr->rcv_nxt[2];
-  BUF->ackno[3] = uip_connr->rcv_nxt[3];
-  
+#if UIP_TCP_SNDQ
+  /* Segments that do not carry queued data get the sequence number
+     that follows the last byte sent. */
+  sndoff = sndq_sentlen(uip_connr);
+ tcp_send_sndoff:
+#if UIP_TCP_SEQ32
+  seq_put(BUF->seqno, uip_connr->snd_nxt + sndoff);
+#else /* UIP_TCP_SEQ32 */
+  uip_add32(uip_connr->snd_nxt, sndoff);
+  BUF->seqno[0] = uip_acc32[0];
+  BUF->seqno[1] = uip_acc32[1];
+  BUF->seqno[2] = uip_acc32[2];
+  BUF->seqno[3] = uip_acc32[3];
+#endif /* UIP_TCP_SEQ32 */
+#elif UIP_TCP_SEQ32
+  seq_put(BUF->seqno, uip_connr->snd_nxt);
+#else /* UIP_TCP_SNDQ */
   BUF->seqno[0] = uip_connr->snd_nxt[0];
   BUF->seqno[1] = uip_connr->snd_nxt[1];
   BUF->seqno[2] = uip_connr->snd_nxt[2];
   BUF->seqno[3] = uip_connr->snd_nxt[3];
+#endif /* UIP_TCP_SNDQ */
+#if UIP_TCP_KEEPALIVE
+ tcp_send_seqno:
+#endif /* UIP_TCP_KEEPALIVE */
+
+#if UIP_TCP_FINE_RTO
+  /* Time a segment that takes up sequence space, unless one is being
+     timed already. Retransmitted segments are not timed. */
+  tmp16 = uip_len - UIP_IPH_LEN - ((BUF->tcpoffset >> 4) << 2);
+  if(BUF->flags & (TCP_SYN | TCP_FIN)) {
+    ++tmp16;
+  }
+  if(tmp16 > 0 && uip_connr->rtt_left == 0 && uip_connr->nrtx == 0
+#if UIP_TCP_SNDQ
+     && !(uip_connr->sndflags & SND_RECOVERY)
+#endif /* UIP_TCP_SNDQ */
+     ) {
+    uip_connr->rtt_time = clock_time();
+#if UIP_TCP_SNDQ
+    uip_connr->rtt_left = sndoff + tmp16;
+#else /* UIP_TCP_SNDQ */
+    uip_connr->rtt_left = tmp16;
+#endif /* UIP_TCP_SNDQ */
+  }
+#endif /* UIP_TCP_FINE_RTO */
+
+#if UIP_TCP_SEQ32
+  seq_put(BUF->ackno, uip_connr->rcv_nxt);
+#else /* UIP_TCP_SEQ32 */
+  BUF->ackno[0] = uip_connr->rcv_nxt[0];
+  BUF->ackno[1] = uip_connr->rcv_nxt[1];
+  BUF->ackno[2] = uip_connr->rcv_nxt[2];
+  BUF->ackno[3] = uip_connr->rcv_nxt[3];
+#endif /* UIP_TCP_SEQ32 */
 
   BUF->proto = UIP_PROTO_TCP;
   
@@ -1826,7 +3646,20 @@ uip_process(u8_t flag)
     BUF->wnd[1] = ((UIP_RECEIVE_WINDOW) & 0xff);
   }
 
+#if UIP_TCP_TIMESTAMPS
+  /* The data has been put after the room for the timestamps option
+     (uip_sappdata). SYNs have their options already. */
+  if((uip_connr->tcpopts & TCP_OPTS_TS) && !(BUF->flags & TCP_SYN)) {
+    tcp_ts_put(&uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN],
+	       uip_connr->ts_recent);
+    uip_len += TCP_OPT_TS_ALIGNED_LEN;
+    BUF->tcpoffset = ((UIP_TCPH_LEN + TCP_OPT_TS_ALIGNED_LEN) / 4) << 4;
+  }
+#endif /* UIP_TCP_TIMESTAMPS */
+
+#if UIP_CONF_IPV6 || UIP_TCP_SYNCOOKIES || UIP_TCP_TW_CONNS
  tcp_send_noconn:
+#endif /* UIP_CONF_IPV6 || UIP_TCP_SYNCOOKIES || UIP_TCP_TW_CONNS */
   BUF->ttl = UIP_TTL;
 #if UIP_CONF_IPV6
   /* For IPv6, the IP length field does not include the IPv6 IP header
@@ -1869,10 +3702,20 @@ uip_process(u8_t flag)
 	       (BUF->len[0] << 8) | BUF->len[1]);
   
   UIP_STAT(++uip_stat.ip.sent);
+#if UIP_TCP_APPSTATE_POOL
+  if(uip_connr != NULL) {
+    tcp_appstate_free(uip_connr);
+  }
+#endif /* UIP_TCP_APPSTATE_POOL */
   /* Return and let the caller do the actual transmission. */
   uip_flags = 0;
   return;
  drop:
+#if UIP_TCP_APPSTATE_POOL
+  if(uip_connr != NULL) {
+    tcp_appstate_free(uip_connr);
+  }
+#endif /* UIP_TCP_APPSTATE_POOL */
   uip_len = 0;
   uip_flags = 0;
   return;